@@ -0,0 +1,42 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Suite run by make bench and by bench without a file */
+#define BENCH_FILE "bench.epd"
+
+/* Most operations read from a single line of the suite */
+#define BENCH_MAX_OPS 16
+
+/******************************************************************************
+ * A bench suite is an EPD file, one position per line: the four position
+ * fields of a fen, then operations each starting with a semicolon:
+ *
+ * - D<depth> <count>: perft to depth, which has to find count leaves
+ * - acd <depth>: search to depth plies
+ *
+ * Blank lines and lines starting with # are skipped. For example:
+ *
+ * rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - ;D4 197281 ;acd 10
+ *
+ * Every operation is run on one thread, then again on g_state.threads if that
+ * is more. The transposition table is cleared before every search, so the
+ * single thread runs always count the same nodes. Their total is the
+ * signature of the build: it only changes when move generation, move
+ * ordering, pruning or the evaluation do.
+ *****************************************************************************/
+
+/*
+ * @brief runs every position of a suite and prints nodes, time and nps for
+ * each operation, then the totals and the signature
+ * @param epd the suite to read, read to the end
+ * @param signature set to the node count of the single thread runs, may be
+ * NULL
+ * @return the number of perft counts that didn't match, -1 if a line could
+ * not be read
+ */
+int runBench(FILE* epd, uint64_t* signature);
+
+#endif /* end of include guard: BENCH_H */
@@ -3,8 +3,91 @@
 
 #include <stdint.h>
 
-int bitScanForward(uint64_t bb);
-int bitScanReverse(uint64_t bb);
+/* 1 when getNumBits compiles to the hardware popcnt instruction, which needs
+ * -mpopcnt or -march=native (see make native) */
+#ifdef __POPCNT__
+#define HW_POPCOUNT 1
+#else
+#define HW_POPCOUNT 0
+#endif
+
+/* Table used for determining bit index without compiler builtins */
+extern const int index64[64];
+
+/*
+ * bitScanForwardPortable
+ * @author Kim Walisch (2012)
+ * @param bb bitboard to scan
+ * @precondition bb != 0
+ * @return index (0..63) of least significant one bit
+ */
+inline int bitScanForwardPortable(uint64_t bb)
+{
+    const uint64_t debruijn64 = 0x03f79d71b4cb0a89UL;
+    return index64[((bb ^ (bb-1)) * debruijn64) >> 58];
+}
+
+/*
+ * bitScanReversePortable
+ * @authors Kim Walisch, Mark Dickinson
+ * @param bb bitboard to scan
+ * @precondition bb != 0
+ * @return index (0..63) of most significant one bit
+ */
+inline int bitScanReversePortable(uint64_t bb)
+{
+    const uint64_t debruijn64 = 0x03f79d71b4cb0a89UL;
+    bb |= bb >> 1;
+    bb |= bb >> 2;
+    bb |= bb >> 4;
+    bb |= bb >> 8;
+    bb |= bb >> 16;
+    bb |= bb >> 32;
+    return index64[(bb * debruijn64) >> 58];
+}
+
+/*
+ * getNumBitsPortable
+ * @param x integer to count the bits of
+ * @return number of set bits in x, counted in parallel within each byte
+ */
+inline int getNumBitsPortable(uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555UL);
+    x = (x & 0x3333333333333333UL) + ((x >> 2) & 0x3333333333333333UL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FUL;
+    return (x * 0x0101010101010101UL) >> 56;
+}
+
+/*
+ * bitScanForward
+ * @param bb bitboard to scan
+ * @precondition bb != 0
+ * @return index (0..63) of least significant one bit
+ */
+inline int bitScanForward(uint64_t bb)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(bb);
+#else
+    return bitScanForwardPortable(bb);
+#endif
+}
+
+/*
+ * bitScanReverse
+ * @param bb bitboard to scan
+ * @precondition bb != 0
+ * @return index (0..63) of most significant one bit
+ */
+inline int bitScanReverse(uint64_t bb)
+{
+#ifdef __GNUC__
+    return 63 ^ __builtin_clzll(bb);
+#else
+    return bitScanReversePortable(bb);
+#endif
+}
 
 /*
  * shiftWrapLeft
@@ -35,9 +118,11 @@ inline uint64_t shiftWrapRight(uint64_t x, int s)
  */
 inline int getNumBits(uint64_t x)
 {
-    int numBits = x ? 1 : 0;
-    while (x &= (x-1)) numBits++;
-    return numBits;
+#if HW_POPCOUNT
+    return __builtin_popcountll(x);
+#else
+    return getNumBitsPortable(x);
+#endif
 }
 
 
@@ -31,6 +31,18 @@
  *   | white kingside
  *   white queenside
  * - Color to play describes whether it is black or white to play.
+ * - occupancy holds every piece of one color, indexed by _WHITE or _BLACK,
+ *   and occupied holds every piece on the board.
+ * - mailbox holds the piece on each square, indexed by square index. Values
+ *   are indexes into pieces (PAWN + BLACK etc.), or NO_PIECE when empty.
+ * - hash is the Zobrist key of the position. It is kept up to date by
+ *   boardMove and undoMove, and covers the pieces, castling, en passant file
+ *   and color to play. Use computeHash to build it from scratch.
+ * - pawnHash is the Zobrist key of the pawns alone, made of the same keys as
+ *   hash. It is kept up to date the same way, see computePawnHash.
+ * - psqtMg and psqtEg are the sums of the middlegame and endgame piece-square
+ *   tables of eval.h over every piece, from white's side. phase is the sum of
+ *   phaseWeights. All three are kept up to date like hash.
  * - Square enums below describe squares in two ways such as A2 and IA2. A2 is
  *   the bitboard with just A2 masked, while IA2 is the index of the square A2.
  *   As such, A2 = 1 << IA2.
@@ -39,6 +51,14 @@ typedef struct
 {
     uint64_t pieces[12];
     uint16_t info;
+    uint64_t hash;
+    uint64_t pawnHash;
+    uint64_t occupancy[2];
+    uint64_t occupied;
+    uint8_t mailbox[64];
+    int16_t psqtMg;
+    int16_t psqtEg;
+    uint8_t phase;
 } Board;
 
 /*
@@ -58,6 +78,7 @@ typedef enum {
     _ROOK,
     _QUEEN,
     _KING,
+    NO_PIECE
 } enumPiece;
 
 /*
@@ -156,6 +177,9 @@ typedef uint32_t Move;
 // Returns a move with the weight set
 #define msetweight(m, v) ((Move)((m & 0x7FFFF) | ((0xFF & v) << 19)))
 
+// Strip the weight or undo information, leaving only the move itself
+#define mgetmove(x)   ((Move)((x) & 0x7FFFF))
+
 // Convert source or destination index to bitboard
 #define indextobb(x)  ((uint64_t)(0x1UL << x))
 
@@ -215,6 +239,67 @@ extern const uint64_t PATTK;  // b2
 extern const uint64_t FILELIST[8];
 extern const uint64_t RANK[8];
 
+/*
+ * @brief Attack tables indexed by square. pawnAttacks is indexed first by the
+ * color of the pawn, _WHITE or _BLACK
+ */
+extern uint64_t knightAttacks[64];
+extern uint64_t kingAttacks[64];
+extern uint64_t pawnAttacks[2][64];
+
+/*
+ * @brief Line tables indexed by two squares. betweenSquares holds the squares
+ * strictly between the two, lineSquares the whole rank, file or diagonal
+ * through both. Both are 0 when the squares don't share a line
+ */
+extern uint64_t betweenSquares[64][64];
+extern uint64_t lineSquares[64][64];
+
+/*
+ * @brief Zobrist keys. Indexed by piece (PAWN + BLACK etc.) and square index,
+ * by the castling nibble of info, and by the en passant file. zobristColor is
+ * added when it is black to play.
+ */
+extern uint64_t zobristPieces[12][64];
+extern uint64_t zobristCastling[16];
+extern uint64_t zobristEnPassant[8];
+extern uint64_t zobristColor;
+
+/*
+ * @brief Initializes the lookup tables used by the board functions. Must be
+ * called once before any Board is created.
+ */
+void initBoard();
+
+/*
+ * @brief Rebuilds occupancy, occupied, mailbox, both hashes and the
+ * piece-square sums from pieces and info.
+ * Call after changing pieces or info directly instead of with boardMove
+ * @param board the board to update
+ */
+void syncBoard(Board *board);
+
+/*
+ * @param board the board to compute the Zobrist key for
+ * @return the Zobrist key of board computed from scratch
+ */
+uint64_t computeHash(Board *board);
+
+/*
+ * @param board the board to compute the pawn key for
+ * @return the Zobrist key of the pawns of board computed from scratch
+ */
+uint64_t computePawnHash(Board *board);
+
+/* 1 when slider lookups use the BMI2 pext instruction instead of magic
+ * numbers, which needs -mbmi2 or -march=native (see make pext). The binary
+ * then only runs on cpus with BMI2 */
+#ifdef __BMI2__
+#define USE_PEXT 1
+#else
+#define USE_PEXT 0
+#endif
+
 /*
  * @param occupancy a bitboard of all of the pieces
  * @param square the square the attacking bishop is attacking from
@@ -246,17 +331,136 @@ void printBitboard(uint64_t bb);
 /*
  * @param board a pointer to a Board struct
  * @param moves a pointer to a preallocated array of type Move
- * @return number of moves in the array
+ * @return number of moves in the array. Each move holds the undo information
+ * for the current position so it can also be passed to undoMove
  */
-int8_t genAllLegalMoves(Board *board, Move *moves);
+int genAllLegalMoves(Board *board, Move *moves);
+
+/*
+ * @param board a pointer to a Board struct
+ * @param moves a pointer to a preallocated array of type Move
+ * @param targets bitboard of the squares moves may land on. En passant lands
+ * on the square of the pawn it takes, so it is kept when that square is a
+ * target
+ * @return number of legal moves landing on targets, encoded like
+ * genAllLegalMoves
+ */
+int genLegalMoves(Board *board, Move *moves, uint64_t targets);
+
+/*
+ * @param board a pointer to a Board struct
+ * @param moves a pointer to a preallocated array of type Move
+ * @return number of legal captures, including en passant, encoded like
+ * genAllLegalMoves
+ */
+int genLegalCaptures(Board *board, Move *moves);
+
+/*
+ * @brief checks a single move without generating the others, for moves
+ * remembered from other positions such as table moves and killers
+ * @param board the position to play move in
+ * @param move any move, only its lower 19 bits are read
+ * @return move encoded like genAllLegalMoves if it is legal in board, 0
+ * otherwise
+ */
+Move legalMove(Board *board, Move move);
+
+/******************************************************************************
+ * Hands out the legal moves of a position in stages, generating each stage
+ * only once the one before it is used up, so a node that cuts off early never
+ * pays for the moves it didn't look at:
+ *
+ * - the move from the transposition table
+ * - captures, including en passant, most valuable victim first and least
+ *   valuable attacker first among those
+ * - up to two killer moves, quiet moves that cut off at this ply elsewhere
+ * - the counter move, the quiet move that last refuted the previous move
+ * - the remaining quiet moves, highest history score first
+ *
+ * Within a stage the best scored move left is picked on every call, so moves
+ * are only sorted as far as the node gets. The table move, killers and
+ * counter move are only played when they are legal here, and are not handed
+ * out again by the later stages. Moves are encoded like genAllLegalMoves.
+ *****************************************************************************/
+typedef struct {
+    Move moves[MAX_MOVES_PER_POSITION];
+    int scores[MAX_MOVES_PER_POSITION];
+    int numMoves;
+    int index;
+    int stage;
+    Move ttMove;
+    Move killers[3];
+    const int (*history)[64];
+} MovePicker;
+
+enum PickerStages {
+    STAGE_TT = 0,
+    STAGE_GEN_CAPTURES,
+    STAGE_CAPTURES,
+    STAGE_KILLER1,
+    STAGE_KILLER2,
+    STAGE_COUNTER,
+    STAGE_GEN_QUIETS,
+    STAGE_QUIETS,
+    STAGE_DONE
+};
+
+/*
+ * @param mp the move picker to set up
+ * @param ttMove move to try first, 0 if there is none
+ * @param killer1 first killer move, 0 if there is none
+ * @param killer2 second killer move, 0 if there is none
+ * @param counter counter move to the previous move, 0 if there is none
+ * @param history history scores of the side to move indexed by source and
+ * destination, quiet moves are ordered by them. NULL leaves quiet moves in
+ * generation order
+ */
+void initMovePicker(MovePicker *mp, Move ttMove, Move killer1, Move killer2,
+                    Move counter, const int history[64][64]);
+
+/*
+ * @param mp a move picker set up with initMovePicker
+ * @param board the position mp is picking moves for. It must be the same
+ * position for every call
+ * @return the next legal move, or 0 once every move was handed out
+ */
+Move nextMove(MovePicker *mp, Board *board);
+
+/*
+ * @param board the board the pieces are on
+ * @param square the square to find attackers of
+ * @param occupancy pieces that block sliders, not always the board's own
+ * @return bitboard of the pieces of both colors attacking square
+ */
+uint64_t attackersTo(Board *board, int square, uint64_t occupancy);
+
+/*
+ * @param board the board to check
+ * @return 1 if the king of the side to move is attacked, 0 otherwise
+ */
+int inCheck(Board *board);
 
 /*
  * @param board a pointer to a Board struct
  * @param move a Move to make on the board
- * @return a move that can be used with undoMove to undo the move
+ * @return a move that can be used with undoMove to undo the move. Pushes
+ * the accumulators of the new position on nnueStack when this thread has one
  */
 Move boardMove(Board *board, Move move);
 
+/*
+ * @brief passes the turn without moving, clearing en passant
+ * @param board the board to pass the turn on
+ * @return the info of board before passing, for undoNullMove
+ */
+uint16_t boardNullMove(Board *board);
+
+/*
+ * @param board the board to undo the null move on
+ * @param info the value boardNullMove returned
+ */
+void undoNullMove(Board *board, uint16_t info);
+
 /*
  * @return A Board initialized to untouched chess board
  */
@@ -297,6 +501,7 @@ uint64_t genPieceAttackMap(Board* board, int pieceType, int color, int square);
  * @param board the board to undo the move on
  * @param move an "undo move" to undo. Undo moves use the upper bits to store
  * the previous board info and a taken piece instead of the move's weight.
+ * Pops the accumulators boardMove pushed
  */
 void undoMove(Board* board, Move move);
 
@@ -2,6 +2,7 @@
 #define ENGINE
 
 #include "board.h"
+#include "nnue.h"
 
 typedef struct {
     uint64_t nodes;
@@ -13,11 +14,244 @@ typedef struct {
     uint64_t checkmates;
 } PerftInfo;
 
+/* Deepest search go will start, used when only time limits the search */
+#define MAX_SEARCH_DEPTH 64
+
+/* Deepest ply the move ordering tables have room for, helpers may search one
+ * ply past MAX_SEARCH_DEPTH
+ */
+#define MAX_PLY (MAX_SEARCH_DEPTH + 2)
+
+/* Scores are in centipawns from the side to move. They have to fit the 16 bit
+ * score of a transposition table entry
+ */
+typedef int Score;
+
+/* Bound of every score, wider than any evaluation or mate */
+#define SCORE_INF 32000
+
+/* Score of mating on the spot, a mate n plies away scores SCORE_MATE - n */
+#define SCORE_MATE 31000
+
+/* Scores at least this far from 0 are mates */
+#define SCORE_MATE_BOUND (SCORE_MATE - MAX_PLY)
+
+/* History scores are halved once one of them passes this */
+#define HISTORY_MAX (1 << 16)
+
+/* Nodes a search thread counts on its own before adding them to the shared
+ * count. The clock and node limit are checked at the same time
+ */
+#define NODE_BATCH 1024
+
+/* Nodes with less depth left than this are searched by a single thread in
+ * YBWC mode, tasks for them would cost more than they save
+ */
+#define YBWC_MIN_DEPTH 3
+
+/* Iterations from this depth on search a window around the score of the last
+ * one, starting ASPIRATION_DELTA centipawns wide on each side and doubling
+ * the step every time the score falls outside
+ */
+#define ASPIRATION_MIN_DEPTH 4
+#define ASPIRATION_DELTA 25
+
+/* Null move pruning needs this much depth left. The null move is searched
+ * NULL_MOVE_REDUCTION plies shallower, one more for every 4 plies of depth
+ */
+#define NULL_MOVE_MIN_DEPTH 3
+#define NULL_MOVE_REDUCTION 2
+
+/* Late move reductions need this much depth left, and leave the first
+ * LMR_MIN_MOVES moves of a node alone
+ */
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 3
+
+/* Futility pruning works on nodes with at most FUTILITY_DEPTH plies left,
+ * with a margin of FUTILITY_MARGIN centipawns for each of them
+ */
+#define FUTILITY_DEPTH 3
+#define FUTILITY_MARGIN 120
+
+/* Selective search techniques, each has a UCI option to switch it off */
+enum SearchPruning {
+    PRUNE_NULL_MOVE = 0x1,
+    PRUNE_LMR = 0x2,
+    PRUNE_FUTILITY = 0x4,
+    PRUNE_ALL = 0x7
+};
+
+/* Plies of the move tree perft splits into tasks by default, set with the
+ * PerftSplit option. Each ply multiplies the tasks by the number of moves,
+ * so more than 2 or 3 only pays off with many threads
+ */
+#define PERFT_SPLIT_DEPTH 2
+#define PERFT_SPLIT_MAX 6
+
+/* Entries in the perft table, 16 bytes each. It is allocated by the first
+ * perftFast and emptied by the later ones
+ */
+#define PERFT_TABLE_SIZE (1 << 20)
+
+/******************************************************************************
+ * A perft table entry, shared by the perft threads without locks the same way
+ * as TTEntry: key holds the position hash XORed with data.
+ *
+ * data holds the leaf count in its upper 56 bits and the depth it was counted
+ * to in its lower 8 bits.
+ *****************************************************************************/
+typedef struct {
+    uint64_t key;
+    uint64_t data;
+} PerftEntry;
+
+/* Ways to split the search between threads, set with the SearchMode option */
+enum SearchModes {
+    SEARCH_LAZY_SMP = 0,
+    SEARCH_YBWC
+};
+
+/******************************************************************************
+ * A node whose moves are being searched by several threads in YBWC mode. It
+ * lives on the stack of the thread that owns the node, which waits for all of
+ * the tasks below it before returning.
+ *
+ * - parent is the split point of the node above, NULL at the root
+ * - alpha only goes up, and is read by every move that starts after it rises
+ * - beta is the bound that makes the node fail high
+ * - cutoff is set once a move reaches beta, so the moves still being searched
+ *   below this node can give up
+ * - bestMove is the move that raised alpha or reached beta, undo encoded
+ * - pv is bestMove followed by the best line below it, 0 terminated. Only
+ *   kept while bestMove raises alpha
+ *****************************************************************************/
+typedef struct SplitPoint {
+    struct SplitPoint* parent;
+    int alpha;
+    int beta;
+    int cutoff;
+    Move bestMove;
+    Move pv[MAX_PLY + 1];
+} SplitPoint;
+
+/******************************************************************************
+ * Move ordering tables. Every search thread has its own, so updating them
+ * needs no locks, and they are cleared at the start of every search.
+ *
+ * - killers are the last two quiet moves that failed high at each ply
+ * - history scores quiet moves by color, source and destination. Moves that
+ *   fail high gain the square of the depth left
+ * - counters is the quiet move that last failed high in reply to a move,
+ *   indexed by the piece that moved (PAWN + BLACK etc.) and its destination
+ * - played is the move being searched at each ply, counters look up the
+ *   move before the current one in it
+ *****************************************************************************/
+typedef struct {
+    Move killers[MAX_PLY][2];
+    int history[2][64][64];
+    Move counters[12][64];
+    Move played[MAX_PLY];
+} OrderTables;
+
+/******************************************************************************
+ * Triangular principal variation table of a search thread. Row ply holds the
+ * best line found from the node at ply, in moves[ply][ply] up to
+ * moves[ply][length[ply] - 1]. A node that raises alpha puts its move in
+ * front of the row of its child.
+ *****************************************************************************/
+typedef struct {
+    Move moves[MAX_PLY + 1][MAX_PLY + 1];
+    int length[MAX_PLY + 1];
+} PvTable;
+
+/******************************************************************************
+ * State owned by a single search thread. Each thread searches its own copy of
+ * the board and root moves, only the transposition table is shared.
+ *
+ * - id is the thread number in the search team, 0 is the main thread whose
+ *   result is played
+ * - depth is the last depth this thread finished, 0 if none
+ * - moves are the root moves, sorted by score after every finished depth
+ * - scores are the scores of moves from the last finished depth. Only the
+ *   first is exact, the others are upper bounds
+ * - score is the exact score of the last finished depth
+ * - pv is the principal variation of the last finished depth, 0 terminated
+ * - nnue holds the network accumulators of the positions the thread is
+ *   searching, only used while a network is loaded
+ *****************************************************************************/
+typedef struct {
+    Board board;
+    int id;
+    int depth;
+    int numMoves;
+    Move moves[MAX_MOVES_PER_POSITION];
+    Score scores[MAX_MOVES_PER_POSITION];
+    Score score;
+    Move pv[MAX_PLY + 1];
+    NnueStack nnue;
+} SearchThread;
+
+/*
+ * @brief fills the lookup tables of the search. Must be called once before
+ * the first search
+ */
+void initSearch();
+
 Move findBestMove(Board* board, uint8_t depth);
-int8_t evaluateBoard(Board* board);
+
+/*
+ * @brief limits the following searches to about nodes nodes. The count is
+ * checked every NODE_BATCH nodes, so each thread may go up to that far over
+ * @param nodes most nodes to search, 0 for no limit
+ */
+void setNodeLimit(uint64_t nodes);
+
+/*
+ * @brief limits the root of the following searches to some of its moves
+ * @param moves moves to search, only their squares and promotion are compared
+ * @param numMoves number of moves, 0 to search every move
+ */
+void setSearchMoves(Move* moves, int numMoves);
+
+/*
+ * @return nodes searched by every thread in the current or last search
+ */
+uint64_t searchedNodes();
+Score evaluateBoard(Board* board);
+
+/*
+ * @brief plays out every capture on the destination of move, each side
+ * capturing with its least valuable piece and stopping when going on would
+ * lose material
+ * @param board the position before move
+ * @param move a capture from genAllLegalMoves or genLegalCaptures
+ * @return centipawns won by the side playing move, negative if it loses
+ */
+int staticExchange(Board* board, Move move);
 void perftRun(Board* board, PerftInfo* pi, uint8_t depth);
 void perftRunThreaded(Board* board, PerftInfo* pi, uint8_t depth);
+
+/*
+ * @brief counts the leaves of the move tree without the other PerftInfo
+ * totals. The last ply is counted straight from genAllLegalMoves, and
+ * subtrees reached again by transposition come from the perft table
+ * @param board the position to count from
+ * @param depth plies to count
+ * @return the number of leaf nodes
+ */
+uint64_t perftFast(Board* board, uint8_t depth);
+
+/*
+ * @brief counts the leaves below every root move the same way as perftFast,
+ * each root move in its own task
+ * @param board the position to count from
+ * @param depth plies to count, including the root move
+ * @param moves filled with the legal moves of board, undo encoded
+ * @param counts filled with the number of leaves below each move
+ * @return the number of moves, 0 when depth is 0
+ */
+int perftDivide(Board* board, uint8_t depth, Move* moves, uint64_t* counts);
 void printPerft(PerftInfo pi);
-int compareMoveWeights(const void* one, const void* two);
 
 #endif
@@ -0,0 +1,77 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdint.h>
+
+#include "board.h"
+
+/* Game phase with every minor piece, rook and queen on the board. Positions
+ * with more (after promotions) count as this
+ */
+#define PHASE_MAX 24
+
+/******************************************************************************
+ * PeSTO piece-square tables with the material of each piece folded in, one
+ * for the middlegame and one for the endgame. They are indexed by piece and
+ * color added together (PAWN + BLACK etc.) and square index, and score from
+ * white's side: black pieces have negative values.
+ *
+ * Board keeps the sum of both tables over its pieces up to date as pieces
+ * move, evaluateBoard blends the two sums by the game phase.
+ *****************************************************************************/
+extern int16_t psqtMg[12][64];
+extern int16_t psqtEg[12][64];
+
+/* How much each piece adds to the game phase, indexed like psqtMg */
+extern const uint8_t phaseWeights[12];
+
+/* Entries in the pawn hash table of each search thread, a power of two */
+#define PAWN_TABLE_SIZE (1 << 13)
+
+/******************************************************************************
+ * An entry of the pawn hash table. Pawn structure terms only depend on where
+ * the pawns are, so they are cached by the pawn key of the board and most
+ * positions in a search find their skeleton already scored.
+ *
+ * - key is the pawnHash of the board the entry was scored for
+ * - mg and eg are the middlegame and endgame pawn structure scores from
+ *   white's side
+ *****************************************************************************/
+typedef struct {
+    uint64_t key;
+    int16_t mg;
+    int16_t eg;
+} PawnEntry;
+
+/*
+ * @brief fills psqtMg and psqtEg. Called by initBoard
+ */
+void initEval();
+
+/*
+ * @brief adds the pawn structure terms of board to mg and eg: passed,
+ * doubled, isolated and backward pawns. Uses the pawn hash table of the
+ * calling thread
+ * @param board the position to score
+ * @param mg middlegame score from white's side
+ * @param eg endgame score from white's side
+ */
+void evaluatePawns(Board *board, int *mg, int *eg);
+
+/*
+ * @brief adds the mobility and king attack terms of board to mg and eg. The
+ * attacks of every knight, bishop, rook and queen are looked up once and used
+ * for both
+ * @param board the position to score
+ * @param mg middlegame score from white's side
+ * @param eg endgame score from white's side
+ */
+void evaluatePieces(Board *board, int *mg, int *eg);
+
+/*
+ * @brief scores the pawn structure of board without the pawn hash table
+ * @param entry set to the pawn key and scores of board
+ */
+void scorePawns(Board *board, PawnEntry *entry);
+
+#endif /* end of include guard: EVAL_H */
@@ -3,12 +3,19 @@
 
 #include <stdint.h>
 
+/* Number of attack patterns for all bishop and rook squares combined */
+#define MAGIC_ATTACKS_SIZE 107648
+
 /*
- * @brief stores the magic number computed for that occupancy mask
+ * @brief stores the magic number computed for that occupancy mask, the shift
+ * that turns the product into an index (64 minus the number of bits in mask)
+ * and the offset of this square's attack patterns in magicAttacks
  */
 typedef struct {
     uint64_t mask;
     uint64_t magic;
+    uint8_t shift;
+    uint32_t offset;
 } Magic;
 
 /*
@@ -22,20 +29,25 @@ extern const Magic magicBishop[64];
  */
 extern const Magic magicRook[64];
 /*
- * @brief stores the attack patterns for bishops. Indexed first by square, then
- * by an index computed by the magic number stored in magicBishop[square]
+ * @brief stores the attack patterns for bishops and rooks packed one square
+ * after another. A square's patterns start at the offset stored in its Magic
+ * and are indexed by the magic number, so each square only takes as many
+ * entries as its mask has occupancies
  */
-extern const uint64_t magicBishopAttacks[64][512];
+extern const uint64_t magicAttacks[MAGIC_ATTACKS_SIZE];
+
 /*
- * @brief stores the attack patterns for rooks. Indexed first by square, then
- * by an index computed by the magic number stored in magicRook[square]
+ * @param occupancy a bitboard of all of the pieces
+ * @param square the square the rook or bishop attacks from
+ * @return the attacks found by walking each ray until a piece blocks it
  */
-extern const uint64_t magicRookAttacks[64][4096];
+uint64_t computeRookAttacks(uint64_t occupancy, int square);
+uint64_t computeBishopAttacks(uint64_t occupancy, int square);
 
 /*
  * computeMagic
  * @brief prints to stdout a source file to populate magicBishop, magicRook,
- * magicBishopAttacks, and magicRookAttacks.
+ * and magicAttacks.
  * @return 0 if magic numbers were successfully found, 1 otherwise
  */
 int computeMagic();
@@ -0,0 +1,237 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stdint.h>
+#include <string.h>     // memcpy()
+
+/* Inputs of the first layer, one for each piece of each color on each square */
+#define NNUE_INPUTS (12 * 64)
+
+/* Neurons in the accumulator of each perspective */
+#define NNUE_HIDDEN 64
+
+/* Neurons in the dense layer between the accumulators and the output */
+#define NNUE_L1 32
+
+/* Activations are clipped to [0, NNUE_CLIP] before the next layer */
+#define NNUE_CLIP 127
+
+/* Sums of the dense layer are divided by 2^NNUE_WEIGHT_SHIFT before clipping */
+#define NNUE_WEIGHT_SHIFT 6
+
+/* The output is divided by 2^NNUE_OUTPUT_SHIFT to get centipawns */
+#define NNUE_OUTPUT_SHIFT 4
+
+/* First bytes of a network file, "LFNN" */
+#define NNUE_MAGIC 0x4E4E464C
+#define NNUE_VERSION 1
+
+/******************************************************************************
+ * A network with two perspectives. Each perspective has an accumulator of
+ * NNUE_HIDDEN neurons fed by one input per piece and square, seen from that
+ * side: for black the colors are swapped and the board flipped. The
+ * accumulators of the side to move and the other side are clipped and
+ * joined, then go through a dense layer of NNUE_L1 neurons and a single
+ * output neuron.
+ *
+ * A network file holds, little endian and in this order: NNUE_MAGIC,
+ * NNUE_VERSION, NNUE_HIDDEN and NNUE_L1 as 32 bit integers, then the fields
+ * below. featureWeights is indexed by input then neuron, l1Weights by neuron
+ * then input.
+ *****************************************************************************/
+typedef struct {
+    int16_t featureBias[NNUE_HIDDEN];
+    int16_t featureWeights[NNUE_INPUTS][NNUE_HIDDEN];
+    int32_t l1Bias[NNUE_L1];
+    int8_t l1Weights[NNUE_L1][2 * NNUE_HIDDEN];
+    int32_t outBias;
+    int8_t outWeights[NNUE_L1];
+} NnueNetwork;
+
+/* Accumulators an NnueStack holds. A search line is at most MAX_PLY plus the
+ * captures of quiescence deep, and each task nested on a thread adds one */
+#define NNUE_STACK_SIZE 256
+
+/* The first layer of the network, indexed by perspective (0 for white) then
+ * neuron */
+typedef int16_t NnueAccumulators[2][NNUE_HIDDEN];
+
+/******************************************************************************
+ * Accumulators of the positions a search thread went through, the position
+ * being searched on top. Boards don't hold accumulators: while a thread has a
+ * stack attached, boardMove pushes a copy of the top and updates it, and
+ * undoMove pops it. A thread without one, and a search without a network,
+ * doesn't keep accumulators at all.
+ *****************************************************************************/
+typedef struct {
+    int top;
+    NnueAccumulators acc[NNUE_STACK_SIZE];
+} NnueStack;
+
+/* Kernels for the dense layer, set with nnueSetKernel */
+enum NnueKernels {
+    NNUE_SCALAR = 0,
+    NNUE_SSE41,
+    NNUE_AVX2
+};
+
+/* The loaded network */
+extern NnueNetwork nnueNet;
+
+/* 1 when a network is loaded and evaluateBoard uses it */
+extern int nnueActive;
+
+/* Stack attached to this thread, NULL when there is none */
+extern __thread NnueStack *nnueStack;
+
+/*
+ * @param path file to load the network from
+ * @return 0 on success, 1 if the file could not be read or is not a network
+ * of this shape. On failure the previous network is kept
+ */
+int nnueLoad(const char *path);
+
+/*
+ * @brief stops using the network, evaluateBoard goes back to the classical
+ * evaluation
+ */
+void nnueDisable();
+
+/*
+ * @param kernel one of NnueKernels
+ * @return 1 if the cpu supports kernel and it is now used, 0 otherwise
+ */
+int nnueSetKernel(int kernel);
+
+/*
+ * @return the fastest kernel the cpu supports
+ */
+int nnueBestKernel();
+
+/*
+ * @brief builds both accumulators from scratch
+ * @param acc the accumulators, indexed by perspective (0 for white) then
+ * neuron
+ * @param pieces the bitboards of a Board
+ */
+void nnueRefresh(int16_t acc[2][NNUE_HIDDEN], const uint64_t pieces[12]);
+
+/*
+ * @brief makes stack the one this thread's board moves update, its only
+ * accumulators built from pieces
+ * @param stack the stack to use, owned by the caller until nnueDetach
+ * @param pieces the bitboards of the Board the thread starts from
+ */
+void nnueAttach(NnueStack *stack, const uint64_t pieces[12]);
+
+/*
+ * @brief stops updating accumulators on this thread
+ */
+void nnueDetach();
+
+/*
+ * @brief starts work on a copy of a board on this thread, for example in a
+ * task. Pushes the accumulators of the board, they may be on another thread's
+ * stack. Does nothing without a stack
+ * @param acc accumulators of the board that was copied, from nnueCurrent
+ * @return the top to give nnueLeave once the copy is done with
+ */
+int nnueEnter(NnueAccumulators *acc);
+
+/*
+ * @param top the value nnueEnter returned
+ */
+void nnueLeave(int top);
+
+/*
+ * @return accumulators of the position on top of this thread's stack, NULL
+ * without a stack
+ */
+inline NnueAccumulators *nnueCurrent()
+{
+    return nnueStack ? &nnueStack->acc[nnueStack->top] : NULL;
+}
+
+/*
+ * @brief pushes a copy of the top accumulators, for boardMove to update
+ * @return the new top, NULL without a stack
+ */
+inline NnueAccumulators *nnuePush()
+{
+    NnueStack *stack = nnueStack;
+    if (!stack) return NULL;
+    memcpy(stack->acc[stack->top + 1], stack->acc[stack->top],
+           sizeof(NnueAccumulators));
+    return &stack->acc[++stack->top];
+}
+
+/*
+ * @brief drops the top accumulators, for undoMove
+ */
+inline void nnuePop()
+{
+    if (nnueStack) nnueStack->top--;
+}
+
+/*
+ * @param acc accumulators kept up to date with the position
+ * @param color color to move, 0 for white
+ * @return score in centipawns from the side to move, kept within
+ * SCORE_MATE_BOUND
+ */
+int nnueEvaluate(int16_t acc[2][NNUE_HIDDEN], int color);
+
+/*
+ * @param perspective 0 for white, 1 for black
+ * @param piece index into Board pieces, for example PAWN + BLACK
+ * @param square square index
+ * @return the input of the network for piece on square seen from perspective
+ */
+inline int nnueFeature(int perspective, int piece, int square)
+{
+    if (perspective)
+    {
+        piece = piece < 6 ? piece + 6 : piece - 6;
+        square ^= 56;
+    }
+    return piece * 64 + square;
+}
+
+/*
+ * The helpers below update both accumulators for a single piece placed on,
+ * taken off or moved between squares
+ */
+inline void nnueAddFeature(int16_t acc[2][NNUE_HIDDEN], int piece, int square)
+{
+    for (int p = 0; p < 2; ++p)
+    {
+        const int16_t *w = nnueNet.featureWeights[nnueFeature(p, piece, square)];
+        for (int i = 0; i < NNUE_HIDDEN; ++i)
+            acc[p][i] += w[i];
+    }
+}
+
+inline void nnueRemoveFeature(int16_t acc[2][NNUE_HIDDEN], int piece,
+                              int square)
+{
+    for (int p = 0; p < 2; ++p)
+    {
+        const int16_t *w = nnueNet.featureWeights[nnueFeature(p, piece, square)];
+        for (int i = 0; i < NNUE_HIDDEN; ++i)
+            acc[p][i] -= w[i];
+    }
+}
+
+inline void nnueMoveFeature(int16_t acc[2][NNUE_HIDDEN], int piece, int src,
+                            int dst)
+{
+    for (int p = 0; p < 2; ++p)
+    {
+        const int16_t *from = nnueNet.featureWeights[nnueFeature(p, piece, src)];
+        const int16_t *to = nnueNet.featureWeights[nnueFeature(p, piece, dst)];
+        for (int i = 0; i < NNUE_HIDDEN; ++i)
+            acc[p][i] += to[i] - from[i];
+    }
+}
+
+#endif /* end of include guard: NNUE_H */
@@ -0,0 +1,61 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <stdint.h>
+
+/* Time in ms kept back from every move for lag between the engine and gui */
+#define TIME_OVERHEAD 30
+
+/* Moves the remaining time is spread over when the gui doesn't say */
+#define TIME_MOVES_TO_GO 30
+
+/* The hard deadline is at most this many times the soft one */
+#define TIME_HARD_FACTOR 4
+
+/******************************************************************************
+ * The time manager turns the clock state sent with go into two deadlines,
+ * both in ms after the search started:
+ *
+ * - soft: no new iteration is started after it
+ * - hard: the search is stopped where it is
+ *
+ * Both are 0 when the search has no time limit.
+ *****************************************************************************/
+
+/*
+ * @return milliseconds from a monotonic clock, only useful for differences
+ */
+uint64_t timeNow();
+
+/*
+ * @brief starts timing a search and sets its deadlines. With movetime both
+ * deadlines are that time, otherwise they are computed from time, inc and
+ * movestogo. When neither is given the search has no time limit
+ * @param time ms left on the clock of the side to move, -1 if not given
+ * @param inc increment in ms per move of the side to move
+ * @param movestogo moves until the next time control, 0 for sudden death
+ * @param movetime ms to search this move for exactly, 0 if not given
+ */
+void timeStart(int time, int inc, int movestogo, int movetime);
+
+/*
+ * @return ms since the search started
+ */
+uint64_t timeElapsed();
+
+/*
+ * @return 1 once the hard deadline has passed
+ */
+int timeUp();
+
+/*
+ * @brief decides if the next iteration of iterative deepening can finish
+ * before the hard deadline. Each iteration is expected to take as many times
+ * longer than the last as the last did than the one before it
+ * @param last ms the iteration that just finished took
+ * @param before ms the iteration before it took, 0 if there wasn't one
+ * @return 1 if the next iteration should be started
+ */
+int timeNextIteration(uint64_t last, uint64_t before);
+
+#endif /* end of include guard: TIMEMAN_H */
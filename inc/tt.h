@@ -0,0 +1,92 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "board.h"
+
+/* Default size of the transposition table in megabytes */
+#define TT_DEFAULT_MB 16
+
+/* Number of entries that share a bucket, 4 entries fill a 64 byte cache line */
+#define TT_BUCKET_SIZE 4
+
+/******************************************************************************
+ * A single transposition table entry. Entries are shared between all search
+ * threads without locks: key holds the position hash XORed with data, so a
+ * torn write from two threads storing at once makes the key check fail and
+ * the entry is treated as a miss.
+ *
+ * data is laid out like so:
+ *
+ * | Generation | Score   | Depth  | Bound  | Move    |
+ * +---------------------------------------------------+
+ * | 8 bits     | 16 bits | 8 bits | 2 bits | 19 bits |
+ * +---------------------------------------------------+
+ *
+ * The first 11 bits are not used.
+ *
+ * - Generation is the search the entry was stored in, old entries are
+ *   replaced first
+ * - Score is the signed score of the position from the side to move
+ * - Depth is the depth left when the entry was stored
+ * - Bound describes whether score is exact or a lower or upper bound
+ * - Move is the best move found, without any weight or undo information.
+ *   0 when no move is known
+ *****************************************************************************/
+typedef struct {
+    uint64_t key;
+    uint64_t data;
+} TTEntry;
+
+enum TTBounds {
+    TT_NONE = 0,
+    TT_UPPER,
+    TT_LOWER,
+    TT_EXACT
+};
+
+// Extract fields from entry data
+#define ttgetmove(x)  ((Move)((x) & 0x7ffff))
+#define ttgetbound(x) ((int)(((x) >> 19) & 0x3))
+#define ttgetdepth(x) ((int)(((x) >> 21) & 0xff))
+#define ttgetscore(x) ((int)(int16_t)(((x) >> 29) & 0xffff))
+#define ttgetgen(x)   ((uint8_t)(((x) >> 45) & 0xff))
+
+/*
+ * @param mb size of the table in megabytes. The number of buckets is rounded
+ * down to a power of two
+ * @return 0 on success, 1 if the table could not be allocated. On failure the
+ * previous table is kept
+ */
+int ttResize(size_t mb);
+
+/*
+ * @brief empties every entry in the table
+ */
+void ttClear();
+
+/*
+ * @brief marks the start of a new search so entries from earlier searches
+ * are replaced before entries from this one
+ */
+void ttNewSearch();
+
+/*
+ * @param hash Zobrist key of the position to look up
+ * @param data set to the entry data when the position is found
+ * @return 1 if the position was found, 0 otherwise
+ */
+int ttProbe(uint64_t hash, uint64_t *data);
+
+/*
+ * @param hash Zobrist key of the position
+ * @param move best move found in the position, 0 if there is none
+ * @param score score of the position
+ * @param depth depth left that the score was searched to
+ * @param bound one of TT_UPPER, TT_LOWER or TT_EXACT
+ */
+void ttStore(uint64_t hash, Move move, int score, int depth, int bound);
+
+#endif /* end of include guard: TT_H */
@@ -10,11 +10,25 @@
 /* The max size of the command buffer, we can increase if need be */
 #define COMMAND_LIMIT 2048
 
-/* Default number of threads for proper uci */
+/* Default number of search threads, change it at runtime with the Threads
+ * option
+ */
 #ifndef NUM_THREADS
 #define NUM_THREADS 3
 #endif
 
+/* Most search threads the Threads option accepts */
+#define MAX_THREADS 256
+
+/* Expands a macro and makes a string literal of it, for option descriptions */
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+/* Threads in the team that runs commands: one reads input, one runs the search
+ * task and one times it. Search threads are started separately
+ */
+#define UCI_THREADS 3
+
 /* Command struct holds the name of the command, and a function pointer to be
  * called to carry out the command
  */
@@ -23,14 +37,30 @@ typedef struct {
     int (*func)(Board*, char*);
 } Command;
 
+/* Option struct holds the name of a uci option, the rest of the line that
+ * describes it to the gui, and a function pointer to be called with the value
+ * string when the option is set
+ */
+typedef struct {
+    char name[32];
+    char description[96];
+    int (*func)(char*);
+} Option;
+
 typedef struct {
     uint8_t flags;
     Move bestMove;
+    int threads;
+    int searchMode;
+    int pruning;
+    int perftSplit;
 } UciState;
 
 enum UciStates {
     UCI_STOP = 0x1,
-    UCI_DEBUG = 0x2
+    UCI_DEBUG = 0x2,
+    UCI_SEARCHING = 0x4,
+    UCI_PONDER = 0x8
 };
 
 /* Defined in main.c */
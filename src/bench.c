@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "board.h"
+#include "engine.h"
+#include "timeman.h"
+#include "tt.h"
+#include "uci.h"
+
+enum BenchOpTypes {
+    BENCH_PERFT = 0,
+    BENCH_SEARCH
+};
+
+/* One operation of a suite line */
+typedef struct {
+    int type;
+    int depth;
+    uint64_t count;
+} BenchOp;
+
+/* Nodes and time of every run on the same number of threads */
+typedef struct {
+    int threads;
+    uint64_t nodes;
+    uint64_t ms;
+} BenchTotal;
+
+/*
+ * Loads the position of an EPD line into board and fills ops with its
+ * operations. Operations other than D<depth> and acd are skipped, so other
+ * suites can be read as they are. Returns the number of operations, or -1 if
+ * the position or an operation is not valid
+ */
+static int parseLine(char* line, Board* board, BenchOp* ops)
+{
+    char* saveptr;
+    char* position = strtok_r(line, ";", &saveptr);
+    // loadFen needs the move counters, which an EPD leaves out. Extra fields
+    // after them are ignored
+    char fen[COMMAND_LIMIT];
+    snprintf(fen, sizeof(fen), "%s 0 1", position);
+    if (!loadFen(board, fen))
+        return -1;
+    int numOps = 0;
+    char* op;
+    while ((op = strtok_r(NULL, ";", &saveptr)) && numOps < BENCH_MAX_OPS)
+    {
+        BenchOp* o = ops + numOps;
+        op += strspn(op, " \t");
+        if (sscanf(op, "D%d %lu", &o->depth, &o->count) == 2)
+            o->type = BENCH_PERFT;
+        else if (sscanf(op, "acd %d", &o->depth) == 1)
+            o->type = BENCH_SEARCH;
+        else
+            continue;
+        if (o->depth < 1 || o->depth > MAX_SEARCH_DEPTH)
+            return -1;
+        numOps++;
+    }
+    return numOps;
+}
+
+/*
+ * Runs op on board with the given number of threads and returns the nodes it
+ * counted, leaves for a perft. ms is set to the time it took
+ */
+static uint64_t runOp(Board* board, const BenchOp* op, int threads,
+                      uint64_t* ms)
+{
+    int oldThreads = g_state.threads;
+    g_state.threads = threads;
+    uint64_t nodes;
+    uint64_t start = timeNow();
+    if (op->type == BENCH_PERFT)
+    {
+        PerftInfo pi = {0};
+        perftRunThreaded(board, &pi, op->depth);
+        nodes = pi.nodes;
+    }
+    else
+    {
+        // Nothing left from the last search may change the tree
+        ttClear();
+        timeStart(-1, 0, 0, 0);
+        setNodeLimit(0);
+        setSearchMoves(NULL, 0);
+        g_state.flags &= ~UCI_STOP;
+        findBestMove(board, op->depth);
+        nodes = searchedNodes();
+    }
+    *ms = timeNow() - start;
+    g_state.threads = oldThreads;
+    return nodes;
+}
+
+/* Nodes per second, or 0 when ms is too short to tell */
+static uint64_t nps(uint64_t nodes, uint64_t ms)
+{
+    return ms ? nodes * 1000 / ms : 0;
+}
+
+int runBench(FILE* epd, uint64_t* signature)
+{
+    BenchTotal totals[2] = { {1, 0, 0}, {g_state.threads, 0, 0} };
+    int numTotals = g_state.threads > 1 ? 2 : 1;
+    BenchOp ops[BENCH_MAX_OPS];
+    Board board;
+    int mismatches = 0;
+    int lineNumber = 0;
+    int position = 0;
+    char* line = NULL;
+    size_t size = 0;
+    while (getline(&line, &size, epd) != -1)
+    {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char* start = line + strspn(line, " \t");
+        if (!*start || *start == '#')
+            continue;
+        int numOps = parseLine(start, &board, ops);
+        if (numOps < 0)
+        {
+            fprintf(stderr, "Could not read bench line %d\n", lineNumber);
+            free(line);
+            return -1;
+        }
+        position++;
+        for (int i = 0; i < numOps; ++i)
+        {
+            for (int t = 0; t < numTotals; ++t)
+            {
+                uint64_t ms;
+                uint64_t nodes = runOp(&board, ops + i, totals[t].threads, &ms);
+                int failed = ops[i].type == BENCH_PERFT
+                          && nodes != ops[i].count;
+                mismatches += failed;
+                totals[t].nodes += nodes;
+                totals[t].ms += ms;
+                printf("Position %d: %s %d, %d threads: %lu nodes %lu ms "
+                       "%lu nps%s\n", position,
+                       ops[i].type == BENCH_PERFT ? "perft" : "search",
+                       ops[i].depth, totals[t].threads, nodes, ms,
+                       nps(nodes, ms), failed ? " FAILED" : "");
+                if (failed)
+                    fprintf(stderr, "Position %d: perft %d expected %lu "
+                            "nodes, found %lu\n", position, ops[i].depth,
+                            ops[i].count, nodes);
+            }
+        }
+    }
+    free(line);
+    printf("\n");
+    for (int t = 0; t < numTotals; ++t)
+        printf("Total, %d threads: %lu nodes %lu ms %lu nps\n",
+               totals[t].threads, totals[t].nodes, totals[t].ms,
+               nps(totals[t].nodes, totals[t].ms));
+    printf("Perft mismatches: %d\n", mismatches);
+    printf("Signature: %lu\n", totals[0].nodes);
+    fflush(stdout);
+    if (signature) *signature = totals[0].nodes;
+    return mismatches;
+}
@@ -13,38 +13,15 @@ const int index64[64] = {
 };
 
 /*
- * bitScanForward
- * @author Kim Walisch (2012)
- * @param bb bitboard to scan
- * @precondition bb != 0
- * @return index (0..63) of least significant one bit
+ * The helpers are defined inline in bitHelpers.h so they are inlined at call
+ * sites. These declarations emit one out of line copy for calls the compiler
+ * chooses not to inline
  */
-int bitScanForward(uint64_t bb)
-{
-    if (bb == 0)
-        return 0;
-    const uint64_t debruijn64 = 0x03f79d71b4cb0a89UL;
-    return index64[((bb ^ (bb-1)) * debruijn64) >> 58];
-}
-
-/*
- * bitScanReverse
- * @authors Kim Walisch, Mark Dickinson
- * @param bb bitboard to scan
- * @precondition bb != 0
- * @return index (0..63) of most significant one bit
- */
-int bitScanReverse(uint64_t bb)
-{
-    if (bb == 0)
-        return 0;
-    const uint64_t debruijn64 = 0x03f79d71b4cb0a89UL;
-    bb |= bb >> 1;
-    bb |= bb >> 2;
-    bb |= bb >> 4;
-    bb |= bb >> 8;
-    bb |= bb >> 16;
-    bb |= bb >> 32;
-    return index64[(bb * debruijn64) >> 58];
-}
-
+extern inline int bitScanForwardPortable(uint64_t bb);
+extern inline int bitScanReversePortable(uint64_t bb);
+extern inline int getNumBitsPortable(uint64_t x);
+extern inline int bitScanForward(uint64_t bb);
+extern inline int bitScanReverse(uint64_t bb);
+extern inline uint64_t shiftWrapLeft(uint64_t x, int s);
+extern inline uint64_t shiftWrapRight(uint64_t x, int s);
+extern inline int getNumBits(uint64_t x);
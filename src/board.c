@@ -2,10 +2,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#ifdef __BMI2__
+#include <immintrin.h>  // _pext_u64(), used when USE_PEXT is set
+#endif
 
 #include "board.h"
 #include "bitHelpers.h"
+#include "eval.h"
 #include "magic.h"
+#include "nnue.h"
 
 /* Constants for piece attacks */
 const uint64_t RDIAG = 0x0102040810204080UL;
@@ -38,6 +44,220 @@ const uint64_t RANK[8] = {
     0xFF00000000000000UL
 };
 
+/* Attack and line tables, filled in by initBoard */
+uint64_t knightAttacks[64];
+uint64_t kingAttacks[64];
+uint64_t pawnAttacks[2][64];
+uint64_t betweenSquares[64][64];
+uint64_t lineSquares[64][64];
+
+/* Zobrist keys, filled in by initBoard */
+uint64_t zobristPieces[12][64];
+uint64_t zobristCastling[16];
+uint64_t zobristEnPassant[8];
+uint64_t zobristColor;
+
+/*
+ * xorshift64* generator with a fixed seed so that keys are the same on every
+ * run
+ */
+static uint64_t zobristRand()
+{
+    static uint64_t state = 0x9E3779B97F4A7C15UL;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DUL;
+}
+
+#if USE_PEXT
+static void initPext();
+#endif
+
+void initBoard()
+{
+    int i, j;
+#if USE_PEXT
+    initPext();
+#endif
+    for (i = 0; i < 64; ++i)
+    {
+        uint64_t b = indextobb(i);
+        knightAttacks[i] = ((b << 17) & ~AFILE) | ((b << 15) & ~HFILE)
+                         | ((b << 10) & ~(AFILE | FILELIST[1]))
+                         | ((b <<  6) & ~(HFILE | FILELIST[6]))
+                         | ((b >> 17) & ~HFILE) | ((b >> 15) & ~AFILE)
+                         | ((b >> 10) & ~(HFILE | FILELIST[6]))
+                         | ((b >>  6) & ~(AFILE | FILELIST[1]));
+        kingAttacks[i] = (b << 8) | (b >> 8)
+                       | ((b << 1) & ~AFILE) | ((b >> 1) & ~HFILE)
+                       | ((b << 9) & ~AFILE) | ((b << 7) & ~HFILE)
+                       | ((b >> 7) & ~AFILE) | ((b >> 9) & ~HFILE);
+        pawnAttacks[_WHITE][i] = ((b << 9) & ~AFILE) | ((b << 7) & ~HFILE);
+        pawnAttacks[_BLACK][i] = ((b >> 7) & ~AFILE) | ((b >> 9) & ~HFILE);
+    }
+    // Squares between and on the line through two squares sharing a rank,
+    // file or diagonal. Both are empty for squares that don't line up
+    for (i = 0; i < 64; ++i)
+    {
+        for (j = 0; j < 64; ++j)
+        {
+            betweenSquares[i][j] = 0UL;
+            lineSquares[i][j] = 0UL;
+            if (i == j) continue;
+            if (magicLookupBishop(0UL, i) & indextobb(j))
+            {
+                betweenSquares[i][j] = magicLookupBishop(indextobb(j), i)
+                                     & magicLookupBishop(indextobb(i), j);
+                lineSquares[i][j] = (magicLookupBishop(0UL, i)
+                                  & magicLookupBishop(0UL, j))
+                                  | indextobb(i) | indextobb(j);
+            }
+            else if (magicLookupRook(0UL, i) & indextobb(j))
+            {
+                betweenSquares[i][j] = magicLookupRook(indextobb(j), i)
+                                     & magicLookupRook(indextobb(i), j);
+                lineSquares[i][j] = (magicLookupRook(0UL, i)
+                                  & magicLookupRook(0UL, j))
+                                  | indextobb(i) | indextobb(j);
+            }
+        }
+    }
+    for (i = 0; i < 12; ++i)
+        for (j = 0; j < 64; ++j)
+            zobristPieces[i][j] = zobristRand();
+    for (i = 0; i < 16; ++i)
+        zobristCastling[i] = zobristRand();
+    for (i = 0; i < 8; ++i)
+        zobristEnPassant[i] = zobristRand();
+    zobristColor = zobristRand();
+    initEval();
+}
+
+/*
+ * Returns the part of the Zobrist key that comes from the info section of a
+ * board: castling, en passant file and color to play
+ */
+static inline uint64_t infoHash(uint16_t info)
+{
+    uint64_t hash = zobristCastling[bgetcas(info)];
+    if (bgetenp(info))
+        hash ^= zobristEnPassant[(info >> 5) & 0x7];
+    if (bgetcol(info))
+        hash ^= zobristColor;
+    return hash;
+}
+
+uint64_t computeHash(Board *board)
+{
+    uint64_t hash = infoHash(board->info);
+    for (int i = 0; i < 12; ++i)
+    {
+        uint64_t pieces = board->pieces[i];
+        while (pieces)
+        {
+            hash ^= zobristPieces[i][bitScanForward(pieces)];
+            pieces &= pieces - 1;
+        }
+    }
+    return hash;
+}
+
+uint64_t computePawnHash(Board *board)
+{
+    uint64_t hash = 0;
+    for (int i = PAWN + WHITE; i <= PAWN + BLACK; i += BLACK)
+        for (uint64_t pawns = board->pieces[i]; pawns; pawns &= pawns - 1)
+            hash ^= zobristPieces[i][bitScanForward(pawns)];
+    return hash;
+}
+
+void syncBoard(Board *board)
+{
+    board->occupancy[_WHITE] = 0UL;
+    board->occupancy[_BLACK] = 0UL;
+    memset(board->mailbox, NO_PIECE, sizeof(board->mailbox));
+    board->psqtMg = 0;
+    board->psqtEg = 0;
+    board->phase = 0;
+    for (int i = 0; i < 12; ++i)
+    {
+        board->occupancy[i >= BLACK] |= board->pieces[i];
+        for (uint64_t pieces = board->pieces[i]; pieces; pieces &= pieces - 1)
+        {
+            int square = bitScanForward(pieces);
+            board->mailbox[square] = i;
+            board->psqtMg += psqtMg[i][square];
+            board->psqtEg += psqtEg[i][square];
+            board->phase += phaseWeights[i];
+        }
+    }
+    board->occupied = board->occupancy[_WHITE] | board->occupancy[_BLACK];
+    board->hash = computeHash(board);
+    board->pawnHash = computePawnHash(board);
+}
+
+/*
+ * The helpers below change a single piece on the board and keep the cached
+ * occupancy, mailbox, hashes and piece-square sums in step with pieces, and
+ * acc too unless it is NULL. piece is the index into pieces, for example
+ * PAWN + BLACK
+ */
+static inline void addPiece(Board *board, int piece, int square,
+                            NnueAccumulators *acc)
+{
+    uint64_t bb = indextobb(square);
+    board->pieces[piece] ^= bb;
+    board->occupancy[piece >= BLACK] ^= bb;
+    board->occupied ^= bb;
+    board->mailbox[square] = piece;
+    board->hash ^= zobristPieces[piece][square];
+    if (piece == PAWN + WHITE || piece == PAWN + BLACK)
+        board->pawnHash ^= zobristPieces[piece][square];
+    board->psqtMg += psqtMg[piece][square];
+    board->psqtEg += psqtEg[piece][square];
+    board->phase += phaseWeights[piece];
+    if (acc)
+        nnueAddFeature(*acc, piece, square);
+}
+
+static inline void removePiece(Board *board, int piece, int square,
+                               NnueAccumulators *acc)
+{
+    uint64_t bb = indextobb(square);
+    board->pieces[piece] ^= bb;
+    board->occupancy[piece >= BLACK] ^= bb;
+    board->occupied ^= bb;
+    board->mailbox[square] = NO_PIECE;
+    board->hash ^= zobristPieces[piece][square];
+    if (piece == PAWN + WHITE || piece == PAWN + BLACK)
+        board->pawnHash ^= zobristPieces[piece][square];
+    board->psqtMg -= psqtMg[piece][square];
+    board->psqtEg -= psqtEg[piece][square];
+    board->phase -= phaseWeights[piece];
+    if (acc)
+        nnueRemoveFeature(*acc, piece, square);
+}
+
+static inline void movePiece(Board *board, int piece, int src, int dst,
+                             NnueAccumulators *acc)
+{
+    uint64_t bb = indextobb(src) | indextobb(dst);
+    board->pieces[piece] ^= bb;
+    board->occupancy[piece >= BLACK] ^= bb;
+    board->occupied ^= bb;
+    board->mailbox[src] = NO_PIECE;
+    board->mailbox[dst] = piece;
+    board->hash ^= zobristPieces[piece][src] ^ zobristPieces[piece][dst];
+    if (piece == PAWN + WHITE || piece == PAWN + BLACK)
+        board->pawnHash ^= zobristPieces[piece][src]
+                          ^ zobristPieces[piece][dst];
+    board->psqtMg += psqtMg[piece][dst] - psqtMg[piece][src];
+    board->psqtEg += psqtEg[piece][dst] - psqtEg[piece][src];
+    if (acc)
+        nnueMoveFeature(*acc, piece, src, dst);
+}
+
 /**
  * Pseudo rotate a bitboard 45 degree clockwise.
  * Main Diagonal is mapped to 1st rank
@@ -72,20 +292,65 @@ uint64_t pseudoRotate45antiClockwise (uint64_t x)
     return x;
 }
 
+/* Attacks for the slider described by m, from the magic number tables */
+static inline uint64_t magicIndexLookup(uint64_t occupancy, const Magic *m)
+{
+    return magicAttacks[m->offset + (((occupancy & m->mask) * m->magic)
+                                     >> m->shift)];
+}
+
+#if USE_PEXT
+
+/*
+ * Attack patterns indexed by pext of the occupancy and the square's mask.
+ * A square has as many pext indexes as magic ones, so the offsets stored in
+ * magicBishop and magicRook are reused
+ */
+static uint64_t pextAttacks[MAGIC_ATTACKS_SIZE];
+
+/* Fills pextAttacks from the magic tables */
+static void initPext()
+{
+    for (int square = 0; square < 64; ++square)
+    {
+        const Magic *magics[2] = { &magicBishop[square], &magicRook[square] };
+        for (int i = 0; i < 2; ++i)
+        {
+            // Walk every subset of the mask
+            uint64_t occupancy = 0UL;
+            do {
+                pextAttacks[magics[i]->offset + _pext_u64(occupancy,
+                                                          magics[i]->mask)] =
+                    magicIndexLookup(occupancy, magics[i]);
+                occupancy = (occupancy - magics[i]->mask) & magics[i]->mask;
+            } while (occupancy);
+        }
+    }
+}
+
+/* Attacks for the slider described by m, from the pext tables */
+static inline uint64_t pextLookup(uint64_t occupancy, const Magic *m)
+{
+    return pextAttacks[m->offset + _pext_u64(occupancy, m->mask)];
+}
+#endif
+
 uint64_t magicLookupBishop(uint64_t occupancy, enumIndexSquare square)
 {
-    occupancy &= magicBishop[square].mask;
-    occupancy *= magicBishop[square].magic;
-    occupancy >>= 64 - getNumBits(magicBishop[square].mask);
-    return magicBishopAttacks[square][occupancy];
+#if USE_PEXT
+    return pextLookup(occupancy, &magicBishop[square]);
+#else
+    return magicIndexLookup(occupancy, &magicBishop[square]);
+#endif
 }
 
 uint64_t magicLookupRook(uint64_t occupancy, enumIndexSquare square)
 {
-    occupancy &= magicRook[square].mask;
-    occupancy *= magicRook[square].magic;
-    occupancy >>= 64 - getNumBits(magicRook[square].mask);
-    return magicRookAttacks[square][occupancy];
+#if USE_PEXT
+    return pextLookup(occupancy, &magicRook[square]);
+#else
+    return magicIndexLookup(occupancy, &magicRook[square]);
+#endif
 }
 
 void printBitboard(uint64_t bb)
@@ -138,72 +403,14 @@ void printBoardInfo(uint16_t info)
             (bgetcol(info) & 0x1) ? 'B' : 'W');
 }
 
-uint64_t genPassiveKingMoves(Board* board, int color)
-{
-    uint64_t passive_moves = 0;
-    uint64_t friends = 0;
-    uint64_t foes = 0;
-    int i;
-    for (i = 0; i < 6; ++i)
-    {
-        foes    |= board->pieces[i + (color ^ BLACK)];
-        friends |= board->pieces[i + color];
-    }
-    if (color == WHITE)
-    {
-        if ((bgetcas(board->info) & 0x8) && !((B1 | C1 | D1) & (friends | foes)))
-            passive_moves |= C1;
-        if ((bgetcas(board->info) & 0x4) && !((F1 | G1) & (friends | foes)))
-            passive_moves |= G1;
-    }
-    else
-    {
-        if ((bgetcas(board->info) & 0x2) && !((B8 | C8 | D8) & (friends | foes)))
-            passive_moves |= C8;
-        if ((bgetcas(board->info) & 0x1) && !((F8 | G8) & (friends | foes)))
-            passive_moves |= G8;
-    }
-    return passive_moves;
-}
-
-uint64_t genPassivePawnMoves(Board* board, int color, int square)
-{
-    int i;
-    uint64_t friends = 0;
-    uint64_t foes = 0;
-    for (i = 0; i < 6; ++i)
-    {
-        foes    |= board->pieces[i + (color ^ BLACK)];
-        friends |= board->pieces[i + color];
-    }
-    uint64_t passiveMoves = 0;
-    if (color == WHITE)
-        passiveMoves |= 0x1UL << (square + 8);
-    else
-        passiveMoves |= 0x1UL << (square - 8);
-
-    passiveMoves ^= (passiveMoves & (friends | foes));
-    if (((square / 8) == 1) && (color == WHITE))
-        passiveMoves |= passiveMoves << 8;
-    else if (((square / 8) == 6) && (color == BLACK))
-        passiveMoves |= passiveMoves >> 8;
-    return passiveMoves ^ (passiveMoves & (friends | foes));
-}
-
 uint64_t genPieceAttackMap(Board* board, int pieceType, int color, int square)
 {
     uint64_t attacks = 0;
     uint64_t bitmap = 0;
     int color_to_move = color;
     int file;
-    int i;
-    uint64_t friends = 0;
-    uint64_t foes = 0;
-    for (i = 0; i < 6; ++i)
-    {
-        foes    |= board->pieces[i + (color_to_move ^ BLACK)];
-        friends |= board->pieces[i + color_to_move];
-    }
+    uint64_t friends = board->occupancy[color_to_move == BLACK];
+    uint64_t occupancy = board->occupied;
     switch(pieceType) {
         case PAWN:
             file = square % 8 - C3 % 8;
@@ -244,18 +451,18 @@ uint64_t genPieceAttackMap(Board* board, int pieceType, int color, int square)
             break;
 
         case BISHOP:
-            attacks = magicLookupBishop((friends | foes), square);
+            attacks = magicLookupBishop(occupancy, square);
             bitmap |= attacks ^ (attacks & friends);
             break;
 
         case ROOK:
-            attacks = magicLookupRook((friends | foes), square);
+            attacks = magicLookupRook(occupancy, square);
             bitmap |= attacks ^ (attacks & friends);
             break;
 
         case QUEEN:
-            attacks  = magicLookupRook((friends | foes), square);
-            attacks |= magicLookupBishop((friends | foes), square);
+            attacks  = magicLookupRook(occupancy, square);
+            attacks |= magicLookupBishop(occupancy, square);
             bitmap  |= attacks ^ (attacks & friends);
             break;
 
@@ -303,154 +510,475 @@ uint64_t genAllAttackMap(Board* board, int color)
 
 void undoMove(Board* board, Move move)
 {
+    nnuePop();
+
     // Restore boardinfo
+    board->hash ^= infoHash(board->info);
     board->info = mgetprevinfo(move);
+    board->hash ^= infoHash(board->info);
     int move_color = (mgetcol(move)) ? BLACK : WHITE;
 
-    // Undo move
-    board->pieces[move_color + mgetpiece(move)] ^= (mgetsrcbb(move)
-                                                  | mgetdstbb(move));
+    // Undo move, turning a promoted piece back into its pawn
+    if (mgetprom(move))
+    {
+        removePiece(board, move_color + mgetprom(move), mgetdst(move), NULL);
+        addPiece(board, move_color + PAWN, mgetsrc(move), NULL);
+    }
+    else
+        movePiece(board, move_color + mgetpiece(move), mgetdst(move),
+                  mgetsrc(move), NULL);
     /* Move rooks when castling */
     /* White Kingside */
     if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE1)
                                   && (mgetdst(move) == IG1))
-        board->pieces[ROOK + WHITE] ^= H1 | F1;
+        movePiece(board, ROOK + WHITE, IF1, IH1, NULL);
     /* White Queenside */
     else if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE1)
                                        && (mgetdst(move) == IC1))
-        board->pieces[ROOK + WHITE] ^= A1 | D1;
+        movePiece(board, ROOK + WHITE, ID1, IA1, NULL);
     /* Black Kingside */
     else if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE8)
                                        && (mgetdst(move) == IG8))
-        board->pieces[ROOK + BLACK] ^= H8 | F8;
+        movePiece(board, ROOK + BLACK, IF8, IH8, NULL);
     /* Black Queenside */
     else if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE8)
                                        && (mgetdst(move) == IC8))
-        board->pieces[ROOK + BLACK] ^= A8 | D8;
+        movePiece(board, ROOK + BLACK, ID8, IA8, NULL);
 
     // restore taken piece
     if (mgettaken(move) != 0x7) {
+        int taken_square = mgetdst(move);
         if (bgetenp(board->info) && bgetenpsquare(board->info) == mgetdst(move)
             && mgettaken(move) == PAWN)
-            board->pieces[(move_color^BLACK) + mgettaken(move)]
-                ^= move_color == WHITE ?
-                mgetdstbb(move) >> 8 : mgetdstbb(move) << 8;
-        else
-            board->pieces[(move_color^BLACK) + mgettaken(move)] ^=
-                mgetdstbb(move);
+            taken_square += (move_color == WHITE) ? -8 : 8;
+        addPiece(board, (move_color^BLACK) + mgettaken(move), taken_square,
+                 NULL);
     }
 }
 
-int checkIfLegal(Board* board, Move* move)
+uint64_t attackersTo(Board *board, int square, uint64_t occupancy)
 {
-    *move = boardMove(board, *move);
-    uint16_t prev_info = mgetprevinfo(*move);
-    int color_to_move = (bgetcol(board->info)) ? BLACK : WHITE;
-    // Generate bitmap of all attacks from the opposite color
-    uint64_t all_attacks = 0UL;
-    for (int pieceType = 0; pieceType < 6; ++pieceType)
-    {
-        uint64_t piece;
-        uint64_t pieces = board->pieces[pieceType + color_to_move];
-        while ((piece = pieces & -pieces)) {
-            int square = bitScanForward(piece);
-
-            // GET ATTACK BITMAP FOR CURRENT PIECE
-            all_attacks |=
-                genPieceAttackMap(board, pieceType, color_to_move, square);
+    uint64_t diagonal = board->pieces[BISHOP + WHITE] | board->pieces[QUEEN + WHITE]
+                      | board->pieces[BISHOP + BLACK] | board->pieces[QUEEN + BLACK];
+    uint64_t straight = board->pieces[ROOK + WHITE] | board->pieces[QUEEN + WHITE]
+                      | board->pieces[ROOK + BLACK] | board->pieces[QUEEN + BLACK];
+    return (pawnAttacks[_WHITE][square] & board->pieces[PAWN + BLACK])
+         | (pawnAttacks[_BLACK][square] & board->pieces[PAWN + WHITE])
+         | (knightAttacks[square] & (board->pieces[KNIGHT + WHITE]
+                                   | board->pieces[KNIGHT + BLACK]))
+         | (kingAttacks[square] & (board->pieces[KING + WHITE]
+                                 | board->pieces[KING + BLACK]))
+         | (magicLookupBishop(occupancy, square) & diagonal)
+         | (magicLookupRook(occupancy, square) & straight);
+}
 
-            // Iterate to next piece
-            pieces ^= piece;
-        }
-    }
-    int is_legal = 1;
-    // Check if the move was a castle move, if so add square to check against
-    // attack bitmap
-    uint64_t castle_square = 0;
-    if (mgetpiece(*move) == KING)
-    {
-        if (mgetcol(*move) == _WHITE)
-        {
-            if ((bgetcas(prev_info) & 0x8) && (mgetdst(*move) == IC1))
-                castle_square |= D1 | E1;
-            else if ((bgetcas(prev_info) & 0x4) && (mgetdst(*move) == IG1))
-                castle_square |= F1 | E1;
-        }
-        else if (mgetcol(*move) == _BLACK)
-        {
-            if ((bgetcas(prev_info) & 0x2) && (mgetdst(*move) == IC8))
-                castle_square |= D8 | E8;
-            else if ((bgetcas(prev_info) & 0x1) && (mgetdst(*move) == IG8))
-                castle_square |= F8 | E8;
-        }
-    }
+int inCheck(Board *board)
+{
+    int us = bgetcol(board->info);
+    int king = bitScanForward(board->pieces[KING + (us ? BLACK : WHITE)]);
+    return (attackersTo(board, king, board->occupied)
+            & board->occupancy[us ^ 1]) != 0;
+}
 
-    // If king is under attack or the castle square was under attack,
-    // move was not legal
-    if (all_attacks &
-       (board->pieces[(color_to_move ^ BLACK) + KING] | castle_square))
-        is_legal = 0;
-    undoMove(board, *move);
-    return is_legal;
+/*
+ * Returns a bitboard of every square attacked by color, with sliders blocked
+ * by occupancy. Squares holding pieces of either color are included
+ */
+static uint64_t attackedBy(Board *board, int color, uint64_t occupancy)
+{
+    uint64_t attacks;
+    uint64_t pieces = board->pieces[PAWN + color];
+    if (color == WHITE)
+        attacks = ((pieces << 9) & ~AFILE) | ((pieces << 7) & ~HFILE);
+    else
+        attacks = ((pieces >> 7) & ~AFILE) | ((pieces >> 9) & ~HFILE);
+    for (pieces = board->pieces[KNIGHT + color]; pieces; pieces &= pieces - 1)
+        attacks |= knightAttacks[bitScanForward(pieces)];
+    for (pieces = board->pieces[BISHOP + color] | board->pieces[QUEEN + color];
+         pieces; pieces &= pieces - 1)
+        attacks |= magicLookupBishop(occupancy, bitScanForward(pieces));
+    for (pieces = board->pieces[ROOK + color] | board->pieces[QUEEN + color];
+         pieces; pieces &= pieces - 1)
+        attacks |= magicLookupRook(occupancy, bitScanForward(pieces));
+    return attacks | kingAttacks[bitScanForward(board->pieces[KING + color])];
 }
 
 /*
- * Populates the array moves with legal moves that works with undoMove()
- * and returns the number of legal moves. Use MAX_MOVES_PER_POSITION
- * as the max size for moves
+ * Rather than playing every move and checking if the king is attacked, the
+ * checkers, pinned pieces and squares the king can't step on are computed
+ * once. Every other piece is then limited to squares that resolve a check
+ * and, when pinned, to the line between its king and the pinner. Last, the
+ * destinations are limited to targets, en passant counts as landing on the
+ * square of the pawn it takes.
  */
-int8_t genAllLegalMoves(Board *board, Move *moves)
+int genLegalMoves(Board *board, Move *moves, uint64_t targets)
 {
-    uint64_t piece;
-    enumIndexSquare square;
-    uint8_t movecount = 0;
-    int color_to_move = (bgetcol(board->info)) ? BLACK : WHITE;
-    uint64_t foes = 0;
-    for (int i = 0; i < 6; ++i)
-        foes    |= board->pieces[i + (color_to_move ^ BLACK)];
+    int movecount = 0;
+    int color = bgetcol(board->info);
+    int color_to_move = color ? BLACK : WHITE;
+    int enemy_color = color_to_move ^ BLACK;
+    uint64_t friends = board->occupancy[color];
+    uint64_t foes = board->occupancy[color ^ 1];
+    uint64_t occupancy = board->occupied;
+    uint64_t king = board->pieces[KING + color_to_move];
+    int king_square = bitScanForward(king);
+    uint64_t undo_info = (uint64_t)board->info << 3;
+
+    // Sliders see through the king, so it can't step back along their line
+    uint64_t danger = attackedBy(board, enemy_color, occupancy ^ king);
+    uint64_t checkers = attackersTo(board, king_square, occupancy) & foes;
+
+    // Squares that block or capture a single checker. With two checkers only
+    // the king can move
+    uint64_t check_mask = ~0UL;
+    if (checkers)
+        check_mask = (checkers & (checkers - 1)) ? 0UL :
+            checkers | betweenSquares[king_square][bitScanForward(checkers)];
+
+    // Friendly pieces alone between an enemy slider and the king
+    uint64_t pinned = 0;
+    uint64_t diagonal = board->pieces[BISHOP + enemy_color]
+                      | board->pieces[QUEEN + enemy_color];
+    uint64_t straight = board->pieces[ROOK + enemy_color]
+                      | board->pieces[QUEEN + enemy_color];
+    uint64_t pinners = (magicLookupBishop(foes, king_square) & diagonal)
+                     | (magicLookupRook(foes, king_square) & straight);
+    for (; pinners; pinners &= pinners - 1)
+    {
+        uint64_t blockers = betweenSquares[king_square][bitScanForward(pinners)]
+                          & occupancy;
+        if (!(blockers & (blockers - 1)))
+            pinned |= blockers & friends;
+    }
+
+    uint64_t ep_square = bgetenp(board->info) ?
+        indextobb(bgetenpsquare(board->info)) : 0UL;
+
     for (int pieceType = PAWN; pieceType <= KING; ++pieceType)
     {
+        // Only the king can answer a double check
+        if (!check_mask && pieceType != KING) continue;
         uint64_t pieces = board->pieces[pieceType + color_to_move];
-        while ((piece = pieces & -pieces)) {
-            square = bitScanForward(piece);
-            uint64_t dst;
+        for (; pieces; pieces &= pieces - 1)
+        {
+            int square = bitScanForward(pieces);
+            uint64_t piece = indextobb(square);
+            uint64_t bitmap;
+            uint64_t ep_capture = 0UL;
+            switch (pieceType)
+            {
+                case PAWN:
+                    bitmap = pawnAttacks[color][square] & foes;
+                    if (color == _WHITE)
+                    {
+                        uint64_t push = (piece << 8) & ~occupancy;
+                        bitmap |= push | ((push & RANK[2]) << 8 & ~occupancy);
+                    }
+                    else
+                    {
+                        uint64_t push = (piece >> 8) & ~occupancy;
+                        bitmap |= push | ((push & RANK[5]) >> 8 & ~occupancy);
+                    }
+                    ep_capture = pawnAttacks[color][square] & ep_square;
+                    break;
+                case KNIGHT:
+                    bitmap = knightAttacks[square];
+                    break;
+                case BISHOP:
+                    bitmap = magicLookupBishop(occupancy, square);
+                    break;
+                case ROOK:
+                    bitmap = magicLookupRook(occupancy, square);
+                    break;
+                case QUEEN:
+                    bitmap = magicLookupBishop(occupancy, square)
+                           | magicLookupRook(occupancy, square);
+                    break;
+                default:
+                    bitmap = kingAttacks[square] & ~danger;
+                    // Castle through squares that are empty and not attacked
+                    if (!checkers && color == _WHITE)
+                    {
+                        if ((bgetcas(board->info) & 0x8) &&
+                            !((B1 | C1 | D1) & occupancy) &&
+                            !((C1 | D1) & danger))
+                            bitmap |= C1;
+                        if ((bgetcas(board->info) & 0x4) &&
+                            !((F1 | G1) & occupancy) &&
+                            !((F1 | G1) & danger))
+                            bitmap |= G1;
+                    }
+                    else if (!checkers)
+                    {
+                        if ((bgetcas(board->info) & 0x2) &&
+                            !((B8 | C8 | D8) & occupancy) &&
+                            !((C8 | D8) & danger))
+                            bitmap |= C8;
+                        if ((bgetcas(board->info) & 0x1) &&
+                            !((F8 | G8) & occupancy) &&
+                            !((F8 | G8) & danger))
+                            bitmap |= G8;
+                    }
+                    break;
+            }
+            bitmap &= ~friends & targets;
+            if (pieceType != KING)
+            {
+                bitmap &= check_mask;
+                if (piece & pinned)
+                    bitmap &= lineSquares[king_square][square];
+            }
 
-            // GET ATTACK BITMAP FOR CURRENT PIECE
-            uint64_t bitmap =
-                genPieceAttackMap(board, pieceType, color_to_move, square);
-            if (pieceType == PAWN)
+            // En passant removes two pieces from the rank of the pawn, so
+            // check it by looking for attackers on the resulting board
+            if (ep_capture)
             {
-                // Add en passant
-                bitmap &= foes | (bgetenp(board->info) ?
-                              0x1UL << bgetenpsquare(board->info) : 0);
-                bitmap |= genPassivePawnMoves(board, color_to_move, square);
+                uint64_t taken = (color == _WHITE) ? ep_square >> 8
+                                                   : ep_square << 8;
+                uint64_t after = occupancy ^ piece ^ taken ^ ep_square;
+                if (!(taken & targets) ||
+                    (attackersTo(board, king_square, after) & foes & ~taken))
+                    ep_capture = 0UL;
+                bitmap |= ep_capture;
             }
-            if (pieceType == KING)
-                bitmap |= genPassiveKingMoves(board, color_to_move);
 
-            while ((dst = bitmap & -bitmap))
+            for (; bitmap; bitmap &= bitmap - 1)
             {
-                moves[movecount++] = (square << 13)
-                    | (bitScanForward(dst) << 7)
+                int dst = bitScanForward(bitmap);
+                uint64_t taken = (board->mailbox[dst] == NO_PIECE) ? 0x7 :
+                                 board->mailbox[dst] - enemy_color;
+                if (indextobb(dst) & ep_capture)
+                    taken = PAWN;
+                Move move = ((undo_info | taken) << 19)
+                    | (square << 13)
+                    | (dst << 7)
                     | (pieceType << 4)
-                    | bgetcol(board->info);
-
-                // Check if move is legal, if not decrement movecount
-                if (!checkIfLegal(board, (moves + movecount - 1)))
+                    | color;
+                // Pawns reaching the last rank become one of four pieces
+                if (pieceType == PAWN && (indextobb(dst) & (RANK[0] | RANK[7])))
                 {
-                    movecount--;
+                    moves[movecount++] = move | (QUEEN << 1);
+                    moves[movecount++] = move | (KNIGHT << 1);
+                    moves[movecount++] = move | (ROOK << 1);
+                    moves[movecount++] = move | (BISHOP << 1);
                 }
-
-                // Iterate to next move
-                bitmap ^= dst;
+                else
+                    moves[movecount++] = move;
             }
-            // Iterate to next piece
-            pieces ^= piece;
         }
     }
     return movecount;
 }
 
+int genAllLegalMoves(Board *board, Move *moves)
+{
+    return genLegalMoves(board, moves, ~0UL);
+}
+
+int genLegalCaptures(Board *board, Move *moves)
+{
+    return genLegalMoves(board, moves,
+                         board->occupancy[bgetcol(board->info) ^ 1]);
+}
+
+void initMovePicker(MovePicker *mp, Move ttMove, Move killer1, Move killer2,
+                    Move counter, const int history[64][64])
+{
+    mp->numMoves = 0;
+    mp->index = 0;
+    mp->stage = STAGE_TT;
+    mp->ttMove = mgetmove(ttMove);
+    mp->killers[0] = mgetmove(killer1);
+    mp->killers[1] = mgetmove(killer2);
+    mp->killers[2] = mgetmove(counter);
+    mp->history = history;
+}
+
+/*
+ * The piece has to stand on the source, reach the destination on this board
+ * and not leave its king attacked. Castling has to look at every square the
+ * king crosses, so only castling goes through genLegalMoves
+ */
+Move legalMove(Board *board, Move move)
+{
+    move = mgetmove(move);
+    int color = bgetcol(board->info);
+    int us = color ? BLACK : WHITE;
+    int piece = mgetpiece(move);
+    int prom = mgetprom(move);
+    int src = mgetsrc(move);
+    int dst = mgetdst(move);
+    uint64_t srcbb = indextobb(src);
+    uint64_t dstbb = indextobb(dst);
+    uint64_t occupancy = board->occupied;
+    uint64_t foes = board->occupancy[color ^ 1];
+    if (!move || (int)mgetcol(move) != color || piece > KING
+        || board->mailbox[src] != piece + us
+        || (dstbb & board->occupancy[color]))
+        return 0;
+    uint64_t taken = dstbb & foes;
+    int takenType = taken ? board->mailbox[dst] - (us ^ BLACK) : 0x7;
+    // Pawns reaching the last rank have to promote, and only they can
+    int lastRank = piece == PAWN && (dstbb & (RANK[0] | RANK[7]));
+    if (lastRank ? (prom < KNIGHT || prom > QUEEN) : prom != PAWN)
+        return 0;
+    uint64_t reach;
+    switch (piece)
+    {
+        case PAWN:
+        {
+            uint64_t ep = bgetenp(board->info) ?
+                indextobb(bgetenpsquare(board->info)) : 0UL;
+            uint64_t push = color == _WHITE ? (srcbb << 8) & ~occupancy
+                                            : (srcbb >> 8) & ~occupancy;
+            reach = push | (pawnAttacks[color][src] & (foes | ep));
+            reach |= color == _WHITE ? ((push & RANK[2]) << 8) & ~occupancy
+                                     : ((push & RANK[5]) >> 8) & ~occupancy;
+            if (dstbb & ep)
+            {
+                taken = color == _WHITE ? ep >> 8 : ep << 8;
+                takenType = PAWN;
+            }
+            break;
+        }
+        case KNIGHT:
+            reach = knightAttacks[src];
+            break;
+        case BISHOP:
+            reach = magicLookupBishop(occupancy, src);
+            break;
+        case ROOK:
+            reach = magicLookupRook(occupancy, src);
+            break;
+        case QUEEN:
+            reach = magicLookupBishop(occupancy, src)
+                  | magicLookupRook(occupancy, src);
+            break;
+        default:
+            if (src - dst == 2 || dst - src == 2)
+            {
+                Move moves[MAX_MOVES_PER_POSITION];
+                int n = genLegalMoves(board, moves, dstbb);
+                for (int i = 0; i < n; ++i)
+                    if (mgetmove(moves[i]) == move)
+                        return moves[i];
+                return 0;
+            }
+            reach = kingAttacks[src];
+            break;
+    }
+    if (!(reach & dstbb))
+        return 0;
+    // Look for attackers of the king on the board after the move, without
+    // the piece it takes
+    uint64_t after = (occupancy ^ srcbb ^ taken) | dstbb;
+    int king = piece == KING ? dst
+                             : bitScanForward(board->pieces[KING + us]);
+    if (attackersTo(board, king, after) & foes & ~taken)
+        return 0;
+    uint64_t undo_info = (uint64_t)board->info << 3;
+    return ((undo_info | takenType) << 19) | move;
+}
+
+/*
+ * Swaps the best scored move left in the stage to mp->index and returns it,
+ * moving the index past it. One step of a selection sort
+ */
+static Move pickBest(MovePicker *mp)
+{
+    int best = mp->index;
+    for (int i = mp->index + 1; i < mp->numMoves; ++i)
+        if (mp->scores[i] > mp->scores[best])
+            best = i;
+    Move move = mp->moves[best];
+    int score = mp->scores[best];
+    mp->moves[best] = mp->moves[mp->index];
+    mp->scores[best] = mp->scores[mp->index];
+    mp->moves[mp->index] = move;
+    mp->scores[mp->index] = score;
+    mp->index++;
+    return move;
+}
+
+Move nextMove(MovePicker *mp, Board *board)
+{
+    Move move;
+    int i;
+    switch (mp->stage)
+    {
+        case STAGE_TT:
+            mp->stage++;
+            if ((move = legalMove(board, mp->ttMove)))
+                return move;
+            // The later stages only skip a table move that was handed out
+            mp->ttMove = 0;
+            // fall through
+        case STAGE_GEN_CAPTURES:
+            mp->numMoves = genLegalCaptures(board, mp->moves);
+            mp->index = 0;
+            // MVV-LVA from the taken piece the generator already recorded,
+            // a promotion adds the value of the new piece
+            for (i = 0; i < mp->numMoves; ++i)
+                mp->scores[i] = (mgettaken(mp->moves[i])
+                                 + mgetprom(mp->moves[i])) * 8
+                              - mgetpiece(mp->moves[i]);
+            mp->stage++;
+            // fall through
+        case STAGE_CAPTURES:
+            while (mp->index < mp->numMoves)
+            {
+                move = pickBest(mp);
+                if (mgetmove(move) != mp->ttMove)
+                    return move;
+            }
+            mp->stage++;
+            // fall through
+        case STAGE_KILLER1:
+        case STAGE_KILLER2:
+        case STAGE_COUNTER:
+            // Killers come from other positions, so they may not be legal or
+            // may be captures here
+            while (mp->stage <= STAGE_COUNTER)
+            {
+                int k = mp->stage++ - STAGE_KILLER1;
+                Move killer = mp->killers[k];
+                if (killer == mp->ttMove) continue;
+                for (i = 0; i < k; ++i)
+                    if (killer == mp->killers[i]) break;
+                if (i < k) continue;
+                move = legalMove(board, killer);
+                if (move && mgettaken(move) == 0x7)
+                    return move;
+            }
+            // fall through
+        case STAGE_GEN_QUIETS:
+            mp->numMoves = genLegalMoves(board, mp->moves, ~board->occupied);
+            mp->index = 0;
+            // Queen promotions are nearly always worth a look before the
+            // rest
+            for (i = 0; i < mp->numMoves; ++i)
+                mp->scores[i] = mgetprom(mp->moves[i]) == QUEEN ? INT_MAX
+                    : mp->history ? mp->history
+                    [mgetsrc(mp->moves[i])][mgetdst(mp->moves[i])] : 0;
+            mp->stage++;
+            // fall through
+        case STAGE_QUIETS:
+            while (mp->index < mp->numMoves)
+            {
+                Move full = mp->history ? pickBest(mp)
+                                        : mp->moves[mp->index++];
+                move = mgetmove(full);
+                if (move != mp->ttMove && move != mp->killers[0]
+                    && move != mp->killers[1] && move != mp->killers[2])
+                    return full;
+            }
+            mp->stage++;
+            // fall through
+        default:
+            return 0;
+    }
+}
+
 /*
  * Updates the board based on the data provided in
  * move. Assumes the move is legal. Returns a move
@@ -458,51 +986,54 @@ int8_t genAllLegalMoves(Board *board, Move *moves)
  */
 Move boardMove(Board *board, Move move)
 {
+    NnueAccumulators *acc = nnuePush();
+
     /* Remove enemy piece if possible */
     int enemy_piece = 7;
     uint16_t prev_info = board->info;
-    int i;
     int enemy_color = (bgetcol(board->info) == _BLACK) ? WHITE : BLACK;
-    uint64_t enemy_piece_dstbb = mgetdstbb(move);
+    int enemy_square = mgetdst(move);
     if ((mgetpiece(move) == PAWN) && bgetenp(board->info) &&
         (mgetdst(move) == bgetenpsquare(board->info)))
+        enemy_square += (enemy_color == BLACK) ? -8 : 8;
+    if (board->mailbox[enemy_square] != NO_PIECE)
     {
-        if (enemy_color == BLACK)
-            enemy_piece_dstbb >>= 8;
-        else
-            enemy_piece_dstbb <<= 8;
-    }
-    for (i = 0; i < 6; ++i)
-    {
-        if (board->pieces[i + enemy_color] & enemy_piece_dstbb)
-            enemy_piece = i;
-        board->pieces[i + enemy_color] &= ~enemy_piece_dstbb;
+        enemy_piece = board->mailbox[enemy_square] - enemy_color;
+        removePiece(board, board->mailbox[enemy_square], enemy_square, acc);
     }
     prev_info = (prev_info << 3) | (enemy_piece & 0x7);
 
-    /* Remove src piece */
-    board->pieces[mgetpiece(move) + (enemy_color ^ BLACK)] ^= mgetsrcbb(move);
+    /* Remove the castling, en passant and color keys, added back at the end */
+    board->hash ^= infoHash(board->info);
 
-    /* Add dst piece */
-    board->pieces[mgetpiece(move) + (enemy_color ^ BLACK)] ^= mgetdstbb(move);
+    /* Move src piece to dst, a promoting pawn comes off the board */
+    if (mgetprom(move))
+    {
+        removePiece(board, PAWN + (enemy_color ^ BLACK), mgetsrc(move), acc);
+        addPiece(board, mgetprom(move) + (enemy_color ^ BLACK),
+                 mgetdst(move), acc);
+    }
+    else
+        movePiece(board, mgetpiece(move) + (enemy_color ^ BLACK),
+                  mgetsrc(move), mgetdst(move), acc);
 
     /* Move rooks when castling */
     /* White Kingside */
     if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE1)
                                   && (mgetdst(move) == IG1))
-        board->pieces[ROOK + WHITE] ^= H1 | F1;
+        movePiece(board, ROOK + WHITE, IH1, IF1, acc);
     /* White Queenside */
     else if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE1)
                                        && (mgetdst(move) == IC1))
-        board->pieces[ROOK + WHITE] ^= A1 | D1;
+        movePiece(board, ROOK + WHITE, IA1, ID1, acc);
     /* Black Kingside */
     else if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE8)
                                        && (mgetdst(move) == IG8))
-        board->pieces[ROOK + BLACK] ^= H8 | F8;
+        movePiece(board, ROOK + BLACK, IH8, IF8, acc);
     /* Black Queenside */
     else if ((mgetpiece(move) == KING) && (mgetsrc(move) == IE8)
                                        && (mgetdst(move) == IC8))
-        board->pieces[ROOK + BLACK] ^= A8 | D8;
+        movePiece(board, ROOK + BLACK, IA8, ID8, acc);
 
     /* Swap color */
     board->info ^= 0x1;
@@ -543,10 +1074,26 @@ Move boardMove(Board *board, Move move)
             board->info |= ((mgetsrc(move) % 8) << 5);
         }
     }
+    board->hash ^= infoHash(board->info);
 
     return (prev_info << 19) | (move & 0x7ffff);
 }
 
+uint16_t boardNullMove(Board *board)
+{
+    uint16_t prev_info = board->info;
+    board->hash ^= infoHash(board->info);
+    board->info = (board->info & ~(0xf << 5)) ^ 0x1;
+    board->hash ^= infoHash(board->info);
+    return prev_info;
+}
+
+void undoNullMove(Board *board, uint16_t info)
+{
+    board->hash ^= infoHash(board->info) ^ infoHash(info);
+    board->info = info;
+}
+
 Board getDefaultBoard()
 {
     Board b;
@@ -563,6 +1110,7 @@ Board getDefaultBoard()
     b.pieces[BLACK + QUEEN]  = D8;
     b.pieces[BLACK + KING]   = E8;
     b.info = (0xf << 1) | 0x0;
+    syncBoard(&b);
 
     return b;
 }
@@ -726,10 +1274,10 @@ void printMove(Move move)
 
 void printMoveSAN(Move move)
 {
-    fprintf(stderr, "%c%c", mgetsrc(move) % 8 + 'a',
-            mgetsrc(move) / 8 + '1');
-    fprintf(stderr, "%c%c\n", mgetdst(move) % 8 + 'a',
-            mgetdst(move) / 8 + '1');
+    char s[7];
+    sprintLANMove(s, move);
+    s[strlen(s) - 1] = '\n';
+    fprintf(stderr, "%s", s);
 }
 
 int loadFen(Board* board, char* fen)
@@ -814,6 +1362,8 @@ int loadFen(Board* board, char* fen)
     else
         board->info |= (((token[0] - 'a') | 8)) << 5;
 
+    syncBoard(board);
+
     /* Half move counter */
     if (!(token = strtok(NULL, " "))) return 0;
     /* Full move counter */
@@ -872,10 +1422,7 @@ void printFen(Board *board)
     /* Piece placement */
     char piece_chars[] = "PNBRQKpnbrqk";
     uint64_t piece_bb;
-    uint64_t all_pieces = 0UL;
-    for (int i=PAWN; i<=_KING; i++) {
-        all_pieces |= board->pieces[i];
-    }
+    uint64_t all_pieces = board->occupied;
     int skip_counter = 0;
     for (int rank=7; rank >= 0; rank--) {
         for (int file=0; file < 8; file++) {
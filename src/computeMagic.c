@@ -308,8 +308,8 @@ int computeBishopMagic(Magic mBishop[64], uint64_t mBishopAttacks[64][512])
 }
 
 /*
- * Prints to stdout a source file to populate magicBishop, magicRook,
- * magicBishopAttacks, and magicRookAttacks.
+ * Prints to stdout a source file to populate magicBishop, magicRook, and
+ * magicAttacks.
  */
 int computeMagic()
 {
@@ -321,40 +321,49 @@ int computeMagic()
     if ( !computeBishopMagic(mBishop, mBishopAttacks) &&
             !computeRookMagic(mRook, mRookAttacks) )
     {
+        // Each square only needs 2^(mask bits) entries, pack them one after
+        // another into magicAttacks. Bishops come first, then rooks
+        uint32_t offset = 0;
         printf("#include \"magic.h\"\n\n");
         // Bishop magic
         printf("const Magic magicBishop[64] = {\n");
         for (int i=0; i<64; i++)
         {
-            printf("    { 0x%lxUL, 0x%lxUL },\n", mBishop[i].mask, mBishop[i].magic);
+            mBishop[i].shift = 64 - getNumBits(mBishop[i].mask);
+            mBishop[i].offset = offset;
+            offset += 1 << (64 - mBishop[i].shift);
+            printf("    { 0x%lxUL, 0x%lxUL, %d, %d },\n", mBishop[i].mask,
+                   mBishop[i].magic, mBishop[i].shift, mBishop[i].offset);
         }
-        printf("};\n\nconst uint64_t magicBishopAttacks[64][512] = {\n");
+        printf("};\n\n");
+
+        // Rook magic
+        printf("const Magic magicRook[64] = {\n");
         for (int i=0; i<64; i++)
         {
-            printf("    { ");
-            for (int j=0; j<512; j++)
-            {
-                printf("0x%lxUL, ", mBishopAttacks[i][j]);
-            }
-            printf("},\n");
+            mRook[i].shift = 64 - getNumBits(mRook[i].mask);
+            mRook[i].offset = offset;
+            offset += 1 << (64 - mRook[i].shift);
+            printf("    { 0x%lxUL, 0x%lxUL, %d, %d },\n", mRook[i].mask,
+                   mRook[i].magic, mRook[i].shift, mRook[i].offset);
         }
         printf("};\n\n");
 
-        // Rook magic
-        printf("const Magic magicRook[64] = {\n");
+        // Attack patterns
+        printf("const uint64_t magicAttacks[%d] = {\n", offset);
         for (int i=0; i<64; i++)
         {
-            printf("    { 0x%lxUL, 0x%lxUL },\n", mRook[i].mask, mRook[i].magic);
+            printf("    ");
+            for (int j=0; j < (1 << (64 - mBishop[i].shift)); j++)
+                printf("0x%lxUL, ", mBishopAttacks[i][j]);
+            printf("\n");
         }
-        printf("};\n\nconst uint64_t magicRookAttacks[64][4096] = {\n");
         for (int i=0; i<64; i++)
         {
-            printf("    { ");
-            for (int j=0; j<4096; j++)
-            {
+            printf("    ");
+            for (int j=0; j < (1 << (64 - mRook[i].shift)); j++)
                 printf("0x%lxUL, ", mRookAttacks[i][j]);
-            }
-            printf("},\n");
+            printf("\n");
         }
         printf("};\n");
         return 0;
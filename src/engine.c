@@ -1,184 +1,1101 @@
 #include <stdio.h>
-#include <limits.h>     // INT_MIN
-#include <stdlib.h>     // rand()
+#include <stdlib.h>     // malloc()
 #include <stdint.h>     // Fancy integer types
 #include <string.h>     // memcpy()
+#include <math.h>       // log()
 
 #include <omp.h>
 
 #include "engine.h"
 #include "board.h"
 #include "bitHelpers.h"
+#include "eval.h"
+#include "nnue.h"
+#include "tt.h"
+#include "timeman.h"
 #include "uci.h"
 
+/* Weights for PAWN, KNIGHT, BISHOP, ROOK, QUEEN, and KING in centipawns, for
+ * static exchanges */
+static const Score pieceWeights[] = {100, 300, 300, 500, 900, 20000};
+
 /*
- * Returns the net weight of pieces on the board. A positive number
- * indicates an advantage for white, negative for black, 0 for even.
- * A variation of this returns a positive number if the player to
- * move has a better weight.
+ * Blends the middlegame and endgame scores of the board by the game phase.
+ * The piece-square sums are kept up to date by boardMove, the pawn terms
+ * usually come from the pawn hash table and the mobility and king attack
+ * terms take one pass over the pieces. With a network loaded it decides
+ * alone, from the accumulators on top of the thread's stack during a search
+ * and from new ones otherwise. Positive when the player to move is better
  */
-int8_t netWeightOfPieces(Board* board)
-{
-    int8_t weight = 0;
-    // Weights for PAWN, KNIGHT, BISHOP, ROOK, QUEEN, and KING
-    int8_t weights[] = {1, 3, 3, 5, 8, 120};
-    // This line returns positive weight for white
-    // int to_move = WHITE;
-    // This line returns a positive weight for the player moving
-    int to_move = bgetcol(board->info) ? BLACK : WHITE;
-    for (int i=PAWN; i<=KING; i++)
+Score evaluateBoard(Board* board)
+{
+    if (nnueActive)
     {
-        weight += ( getNumBits(board->pieces[i + to_move])
-                -   getNumBits(board->pieces[i + (to_move ^ BLACK)])
-                ) * weights[i];
+        NnueAccumulators *acc = nnueCurrent();
+        NnueAccumulators fresh;
+        if (!acc)
+        {
+            nnueRefresh(fresh, board->pieces);
+            acc = &fresh;
+        }
+        return nnueEvaluate(*acc, bgetcol(board->info));
     }
-    return weight;
+    int mg = board->psqtMg;
+    int eg = board->psqtEg;
+    evaluatePawns(board, &mg, &eg);
+    evaluatePieces(board, &mg, &eg);
+    int phase = board->phase < PHASE_MAX ? board->phase : PHASE_MAX;
+    Score score = (mg * phase + eg * (PHASE_MAX - phase)) / PHASE_MAX;
+    return bgetcol(board->info) ? -score : score;
+}
+
+/* Set by the main search thread when it is done so the helpers stop too */
+static int searchDone = 0;
+
+/*
+ * Returns nonzero once the search has to stop, either because the gui sent
+ * stop or because the main search thread finished
+ */
+static inline int searchStopped()
+{
+    return __atomic_load_n(&searchDone, __ATOMIC_RELAXED)
+        || (__atomic_load_n(&g_state.flags, __ATOMIC_RELAXED) & UCI_STOP);
+}
+
+/*
+ * Mate scores count plies from the root, but the table stores them counted
+ * from the node so they stay right when the node is reached at another ply
+ */
+static inline int scoreToTable(Score score, int ply)
+{
+    if (score >= SCORE_MATE_BOUND) return score + ply;
+    if (score <= -SCORE_MATE_BOUND) return score - ply;
+    return score;
+}
+
+static inline Score scoreFromTable(int score, int ply)
+{
+    if (score >= SCORE_MATE_BOUND) return score - ply;
+    if (score <= -SCORE_MATE_BOUND) return score + ply;
+    return score;
+}
+
+/*
+ * Looks the position up in the transposition table. ttMove is set to the move
+ * stored for it, or 0. Returns 1 and sets score if the stored result already
+ * decides this node for the given window
+ */
+static int probeTable(Board* board, Score alpha, Score beta, int depthleft,
+        int ply, Move* ttMove, Score* score)
+{
+    uint64_t ttData;
+    *ttMove = 0;
+    if (!ttProbe(board->hash, &ttData))
+        return 0;
+    *ttMove = ttgetmove(ttData);
+    if (ttgetdepth(ttData) < depthleft)
+        return 0;
+    Score ttScore = scoreFromTable(ttgetscore(ttData), ply);
+    int bound = ttgetbound(ttData);
+    if ((bound == TT_EXACT || bound == TT_LOWER) && ttScore >= beta)
+        *score = beta;
+    else if ((bound == TT_EXACT || bound == TT_UPPER) && ttScore <= alpha)
+        *score = alpha;
+    else if (bound == TT_EXACT)
+        *score = ttScore;
+    else
+        return 0;
+    return 1;
+}
+
+/* Nodes searched by all threads, each thread adds its own in batches */
+static uint64_t searchNodes = 0;
+
+/* The search stops once searchNodes reaches this, 0 for no limit */
+static uint64_t nodeLimit = 0;
+
+/* Nodes this thread has searched that aren't in searchNodes yet */
+static __thread unsigned int nodesSinceCheck = 0;
+
+void setNodeLimit(uint64_t nodes)
+{
+    nodeLimit = nodes;
+}
+
+uint64_t searchedNodes()
+{
+    return __atomic_load_n(&searchNodes, __ATOMIC_RELAXED);
+}
+
+/*
+ * Adds the nodes this thread counted to searchNodes and returns the new total
+ */
+static inline uint64_t flushNodes()
+{
+    uint64_t nodes = __atomic_add_fetch(&searchNodes, nodesSinceCheck,
+                                        __ATOMIC_RELAXED);
+    nodesSinceCheck = 0;
+    return nodes;
 }
 
-int8_t evaluateBoard(Board* board)
+/*
+ * Counts a node. Every NODE_BATCH nodes the count is made shared and the
+ * search stopped if the hard deadline passed or the node limit was reached
+ */
+static inline void countNode()
 {
-    return netWeightOfPieces(board);
+    if (++nodesSinceCheck < NODE_BATCH) return;
+    uint64_t nodes = flushNodes();
+    if (timeUp() || (nodeLimit && nodes >= nodeLimit))
+        __atomic_store_n(&searchDone, 1, __ATOMIC_RELAXED);
+}
+
+int staticExchange(Board* board, Move move)
+{
+    int square = mgetdst(move);
+    int side = bgetcol(board->info);
+    uint64_t from = mgetsrcbb(move);
+    uint64_t occupancy = board->occupied;
+    uint64_t diagonal = board->pieces[BISHOP + WHITE] | board->pieces[QUEEN + WHITE]
+                      | board->pieces[BISHOP + BLACK] | board->pieces[QUEEN + BLACK];
+    uint64_t straight = board->pieces[ROOK + WHITE] | board->pieces[QUEEN + WHITE]
+                      | board->pieces[ROOK + BLACK] | board->pieces[QUEEN + BLACK];
+    int attacker = mgetpiece(move);
+    int gain[32];
+    int depth = 0;
+
+    // The pawn taken en passant isn't on the square, lift it off the board
+    if (attacker == PAWN && bgetenp(board->info)
+        && square == bgetenpsquare(board->info))
+        occupancy ^= side == _WHITE ? mgetdstbb(move) >> 8
+                                    : mgetdstbb(move) << 8;
+    gain[0] = mgettaken(move) == 0x7 ? 0 : pieceWeights[mgettaken(move)];
+    uint64_t attackers = attackersTo(board, square, occupancy);
+    do {
+        depth++;
+        // What the side capturing next wins if the last capturer is taken
+        gain[depth] = pieceWeights[attacker] - gain[depth - 1];
+        if (-gain[depth - 1] < 0 && gain[depth] < 0) break;
+        // Pieces behind the capturer may now see the square
+        occupancy ^= from;
+        attackers |= (magicLookupBishop(occupancy, square) & diagonal)
+                   | (magicLookupRook(occupancy, square) & straight);
+        attackers &= occupancy;
+        side ^= 1;
+        from = 0;
+        for (attacker = PAWN; attacker <= KING; attacker++)
+        {
+            uint64_t ours = attackers
+                          & board->pieces[attacker + (side ? BLACK : WHITE)];
+            if (ours)
+            {
+                from = ours & -ours;
+                break;
+            }
+        }
+    } while (from && depth < 31);
+    // Either side may stop capturing when going on would lose material
+    while (--depth)
+        gain[depth - 1] = -(-gain[depth - 1] > gain[depth] ? -gain[depth - 1]
+                                                           : gain[depth]);
+    return gain[0];
 }
 
-int alphaBeta( Board* board, int8_t alpha, int8_t beta, int8_t depthleft ) {
-    if ( depthleft == 0 ) return evaluateBoard(board);
+/*
+ * Searches captures until the position is quiet, so leaves aren't evaluated
+ * in the middle of an exchange. The side to move may stand pat on the static
+ * evaluation, and captures that lose material by static exchange are skipped
+ */
+static Score quiesce(Board* board, Score alpha, Score beta)
+{
+    countNode();
+    Score standPat = evaluateBoard(board);
+    if (standPat >= beta) return beta;
+    if (standPat > alpha) alpha = standPat;
+
     Move moves[MAX_MOVES_PER_POSITION];
-    uint8_t numMoves = genAllLegalMoves(board, moves);
+    int numMoves = genLegalCaptures(board, moves);
     int i;
     for (i = 0; i < numMoves; ++i) {
+        // Capturing into a lesser piece is never the only good capture
+        if (mgetprom(moves[i]) && mgetprom(moves[i]) != QUEEN) continue;
+        if (staticExchange(board, moves[i]) < 0) continue;
         Move undo = boardMove(board, moves[i]);
-        int8_t weight = -alphaBeta(board, -beta, -alpha, depthleft - 1 );
+        Score weight = -quiesce(board, -beta, -alpha);
+        undoMove(board, undo);
+        if (searchStopped()) return 0;
+        if (weight >= beta) return beta;
+        if (weight > alpha) alpha = weight;
+    }
+    return alpha;
+}
+
+/* Move ordering tables of this thread */
+static __thread OrderTables order;
+
+/*
+ * Returns the counter move stored for the move played one ply before ply, 0
+ * if there is none
+ */
+static inline Move counterMove(int ply)
+{
+    if (ply < 1) return 0;
+    Move prev = order.played[ply - 1];
+    if (!prev) return 0;
+    return order.counters[mgetpiece(prev) + (mgetcol(prev) ? BLACK : WHITE)]
+                         [mgetdst(prev)];
+}
+
+/*
+ * Rewards a quiet move that failed high at ply with depthleft plies to go. It
+ * becomes the first killer at ply and the counter to the previous move, and
+ * its history score grows
+ */
+static void quietCutoff(Move move, int ply, int depthleft)
+{
+    move = mgetmove(move);
+    if (order.killers[ply][0] != move)
+    {
+        order.killers[ply][1] = order.killers[ply][0];
+        order.killers[ply][0] = move;
+    }
+    if (ply > 0 && order.played[ply - 1])
+    {
+        Move prev = order.played[ply - 1];
+        order.counters[mgetpiece(prev) + (mgetcol(prev) ? BLACK : WHITE)]
+                      [mgetdst(prev)] = move;
+    }
+    int *h = &order.history[mgetcol(move)][mgetsrc(move)][mgetdst(move)];
+    *h += depthleft * depthleft;
+    // Halve everything so old results fade and scores can't overflow
+    if (*h > HISTORY_MAX)
+    {
+        int *all = &order.history[0][0][0];
+        for (int i = 0; i < 2 * 64 * 64; ++i)
+            all[i] /= 2;
+    }
+}
+
+/* Plies taken off late moves, indexed by depth left then move number */
+static int reductions[64][64];
+
+void initSearch()
+{
+    for (int depth = 1; depth < 64; ++depth)
+        for (int move = 1; move < 64; ++move)
+            reductions[depth][move] = 0.5 + log(depth) * log(move) / 2;
+}
+
+/*
+ * Returns the plies to take off the moveNumber-th move of a node with
+ * depthleft plies left, always leaving at least one ply to search
+ */
+static inline int lateReduction(int depthleft, int moveNumber, int pvNode)
+{
+    int r = reductions[depthleft < 64 ? depthleft : 63]
+                      [moveNumber < 64 ? moveNumber : 63];
+    if (pvNode && r > 0) r--;
+    return r < depthleft - 2 ? r : depthleft - 2;
+}
+
+/*
+ * Returns 1 if the side to move has a piece other than pawns and its king.
+ * Without one, zugzwang is common and passing is no proof of anything
+ */
+static inline int hasPieces(Board* board)
+{
+    int us = bgetcol(board->info) ? BLACK : WHITE;
+    return (board->pieces[KNIGHT + us] | board->pieces[BISHOP + us]
+          | board->pieces[ROOK + us] | board->pieces[QUEEN + us]) != 0;
+}
+
+/* Principal variation table of this thread */
+static __thread PvTable pv;
+
+/*
+ * Makes move, undo encoded, followed by the line of the child the best line
+ * of the node at ply
+ */
+static inline void updatePv(Move move, int ply)
+{
+    pv.moves[ply][ply] = mgetmove(move);
+    for (int i = ply + 1; i < pv.length[ply + 1]; ++i)
+        pv.moves[ply][i] = pv.moves[ply + 1][i];
+    pv.length[ply] = pv.length[ply + 1];
+}
+
+/* Copies the best line of the node at ply to line, 0 terminated */
+static void copyPv(Move* line, int ply)
+{
+    int n = 0;
+    for (int i = ply; i < pv.length[ply]; ++i)
+        line[n++] = pv.moves[ply][i];
+    line[n] = 0;
+}
+
+/*
+ * Principal variation search. Only the first move gets the whole window, the
+ * others are expected to fail low and get a null window around alpha. One
+ * that beats it after all is searched again with the whole window. Nodes with
+ * a null window can't be on the principal variation, so only they take
+ * cutoffs from the transposition table and the line stays whole.
+ *
+ * Null window nodes out of check are also pruned, each technique can be
+ * switched off in g_state.pruning:
+ * - reverse futility: near the leaves, a static evaluation beating beta by a
+ *   margin for every ply left fails high right away
+ * - null move: if passing the turn still fails high in a shallower search,
+ *   so will the real moves
+ * - futility: near the leaves, quiet moves that don't give check are skipped
+ *   when the static evaluation is too far below alpha to catch up
+ * - late move reductions: quiet moves late in the order are searched
+ *   shallower first, and only searched fully if they beat alpha
+ */
+Score alphaBeta( Board* board, Score alpha, Score beta, int8_t depthleft,
+                 int ply ) {
+    pv.length[ply] = ply;
+    if ( depthleft <= 0 ) return quiesce(board, alpha, beta);
+    countNode();
+
+    // Check the transposition table for a result from an earlier search
+    int pvNode = beta - alpha > 1;
+    Move ttMove;
+    Score score;
+    if (probeTable(board, alpha, beta, depthleft, ply, &ttMove, &score)
+        && !pvNode)
+        return score;
+
+    int prune = __atomic_load_n(&g_state.pruning, __ATOMIC_RELAXED);
+    int checked = inCheck(board);
+    int futile = 0;
+    if (!pvNode && !checked && beta < SCORE_MATE_BOUND
+        && beta > -SCORE_MATE_BOUND)
+    {
+        Score eval = evaluateBoard(board);
+        if ((prune & PRUNE_FUTILITY) && depthleft <= FUTILITY_DEPTH
+            && eval - FUTILITY_MARGIN * depthleft >= beta)
+            return beta;
+        // Two passes in a row would only search the same position shallower
+        if ((prune & PRUNE_NULL_MOVE) && depthleft >= NULL_MOVE_MIN_DEPTH
+            && eval >= beta && ply > 0 && order.played[ply - 1]
+            && hasPieces(board))
+        {
+            int r = NULL_MOVE_REDUCTION + depthleft / 4;
+            order.played[ply] = 0;
+            uint16_t info = boardNullMove(board);
+            Score weight = -alphaBeta(board, -beta, -beta + 1,
+                                      depthleft - 1 - r, ply + 1);
+            undoNullMove(board, info);
+            if (searchStopped()) return 0;
+            if (weight >= beta)
+                return beta;
+        }
+        futile = (prune & PRUNE_FUTILITY) && depthleft <= FUTILITY_DEPTH
+              && eval + FUTILITY_MARGIN * depthleft <= alpha;
+    }
+
+    // Moves are generated in stages, a cutoff skips the stages after it
+    MovePicker mp;
+    initMovePicker(&mp, ttMove, order.killers[ply][0], order.killers[ply][1],
+                   counterMove(ply), order.history[bgetcol(board->info)]);
+    Move move;
+    Move bestMove = 0;
+    int searched = 0;
+    while ((move = nextMove(&mp, board))) {
+        searched++;
+        order.played[ply] = move;
+        Move undo = boardMove(board, move);
+        int quiet = mgettaken(undo) == 0x7 && !mgetprom(undo);
+        int late = (prune & PRUNE_LMR) && !checked
+                && depthleft >= LMR_MIN_DEPTH && searched > LMR_MIN_MOVES;
+        // Checks are worth a look however bad things seem
+        if (quiet && (futile || late) && inCheck(board))
+            quiet = 0;
+        if (futile && quiet && searched > 1)
+        {
+            undoMove(board, undo);
+            continue;
+        }
+        Score weight;
+        if (searched == 1)
+            weight = -alphaBeta(board, -beta, -alpha, depthleft - 1, ply + 1);
+        else
+        {
+            weight = alpha + 1;
+            int r = late && quiet ? lateReduction(depthleft, searched, pvNode)
+                                  : 0;
+            if (r > 0)
+                weight = -alphaBeta(board, -alpha - 1, -alpha,
+                                    depthleft - 1 - r, ply + 1);
+            if (weight > alpha)
+                weight = -alphaBeta(board, -alpha - 1, -alpha, depthleft - 1,
+                                    ply + 1);
+            if (weight > alpha && weight < beta)
+                weight = -alphaBeta(board, -beta, -alpha, depthleft - 1,
+                                    ply + 1);
+        }
         undoMove(board, undo);
-        if( weight >= beta )
+        // A stopped search returns garbage, don't let it reach the table
+        if (searchStopped()) return 0;
+        if( weight >= beta ) {
+            if (mgettaken(undo) == 0x7)
+                quietCutoff(undo, ply, depthleft);
+            ttStore(board->hash, undo, scoreToTable(beta, ply), depthleft,
+                    TT_LOWER);
             return beta;
-        if( weight > alpha )
+        }
+        if( weight > alpha ) {
             alpha = weight;
+            bestMove = undo;
+            updatePv(undo, ply);
+        }
     }
+    // Checkmated, the sooner the worse. Otherwise stalemate
+    if (!searched)
+        return inCheck(board) ? -SCORE_MATE + ply : 0;
+    ttStore(board->hash, bestMove, scoreToTable(alpha, ply), depthleft,
+            bestMove ? TT_EXACT : TT_UPPER);
     return alpha;
 }
 
-int compareMoveWeights(const void* one, const void* two)
+/*
+ * Returns nonzero if the search below sp is no longer needed, because the
+ * search was stopped or sp or one of its ancestors failed high
+ */
+static inline int splitAborted(SplitPoint* sp)
 {
-    if (mgetweight((*(Move*)one)) > mgetweight((*(Move*)two)))
-        return -1;
-    else if (mgetweight((*(Move*)one)) < mgetweight((*(Move*)two)))
-        return 1;
+    if (searchStopped()) return 1;
+    for (; sp; sp = sp->parent)
+        if (__atomic_load_n(&sp->cutoff, __ATOMIC_RELAXED))
+            return 1;
     return 0;
 }
 
-Move findBestMove(Board* board, uint8_t depth)
+/*
+ * Records the result of a move searched below sp. Raises alpha and keeps move
+ * and the line below it as the best one if weight improves on it, or marks sp
+ * as cut off if weight reaches beta
+ * @return 1 if move is now the best move of sp
+ */
+static int splitResult(SplitPoint* sp, Score weight, Move move,
+        const Move* line)
 {
-    // Assumes MAX_MOVES_PER_POSITION < 256
-    uint8_t i;
-    uint8_t numMoves;
+    int best = 0;
+    #pragma omp critical(splitPoint)
+    {
+        if (weight >= sp->beta && !sp->cutoff)
+        {
+            __atomic_store_n(&sp->cutoff, 1, __ATOMIC_RELAXED);
+            sp->bestMove = move;
+            best = 1;
+        }
+        else if (weight > sp->alpha)
+        {
+            __atomic_store_n(&sp->alpha, weight, __ATOMIC_RELAXED);
+            sp->bestMove = move;
+            sp->pv[0] = mgetmove(move);
+            int i;
+            for (i = 0; line[i]; ++i)
+                sp->pv[i + 1] = line[i];
+            sp->pv[i + 1] = 0;
+            best = 1;
+        }
+    }
+    return best;
+}
 
-    // Setup independent variables for each thread
-    Board boards[NUM_THREADS];
-    for (i=0; i<NUM_THREADS; i++) memcpy(&boards[i], board, sizeof(Board));
-    // MAX_MOVES_PER_POSITION*sizeof(Move) = 218 * 4 = 872 bytes
+/*
+ * Young Brothers Wait: the eldest move is searched first on its own, then its
+ * younger brothers become OpenMP tasks that idle threads in the team pick up.
+ * Each brother reads the alpha of the split point when it starts and searches
+ * its own copy of the board. When one of them fails high the split point is
+ * marked, and everything below it gives up at its next move. Nodes closer to
+ * the leaves than YBWC_MIN_DEPTH aren't worth a task and use alphaBeta.
+ * Brothers search like in alphaBeta, with a null window first, and null
+ * move pruning and late move reductions work the same way. Tasks move
+ * between the PV tables of threads, so the best line is passed up in line
+ * and the split points instead
+ */
+static Score ybwcSearch(Board* board, Score alpha, Score beta,
+        int8_t depthleft, int ply, SplitPoint* parent, Move* line)
+{
+    if (depthleft < YBWC_MIN_DEPTH)
+    {
+        // Nothing else runs on this thread until alphaBeta returns
+        Score score = alphaBeta(board, alpha, beta, depthleft, ply);
+        copyPv(line, ply);
+        return score;
+    }
+    countNode();
+    line[0] = 0;
+
+    int pvNode = beta - alpha > 1;
+    Move ttMove;
+    Score score;
+    if (probeTable(board, alpha, beta, depthleft, ply, &ttMove, &score)
+        && !pvNode)
+        return score;
+
+    int prune = __atomic_load_n(&g_state.pruning, __ATOMIC_RELAXED);
+    int checked = inCheck(board);
+    if ((prune & PRUNE_NULL_MOVE) && !pvNode && !checked
+        && beta < SCORE_MATE_BOUND && beta > -SCORE_MATE_BOUND
+        && ply > 0 && order.played[ply - 1] && hasPieces(board)
+        && evaluateBoard(board) >= beta)
+    {
+        Board child;
+        Move childLine[MAX_PLY + 1];
+        memcpy(&child, board, sizeof(Board));
+        order.played[ply] = 0;
+        boardNullMove(&child);
+        Score weight = -ybwcSearch(&child, -beta, -beta + 1,
+                depthleft - 1 - NULL_MOVE_REDUCTION - depthleft / 4, ply + 1,
+                parent, childLine);
+        if (splitAborted(parent)) return 0;
+        if (weight >= beta)
+            return beta;
+    }
+
+    // Every move is needed up front to hand out as tasks, but the picker
+    // still puts them in order
     Move moves[MAX_MOVES_PER_POSITION];
-    numMoves = genAllLegalMoves(board, moves);
-    for (int curdepth=1; curdepth <= depth; curdepth++) {
-        // Generate tasks for this loop to be parallelized
-        int8_t alpha = -126;
-        int8_t beta = 127;
-        #pragma omp taskloop untied default(shared)
-        for (i=0; i<numMoves; i++)
+    MovePicker mp;
+    initMovePicker(&mp, ttMove, order.killers[ply][0], order.killers[ply][1],
+                   counterMove(ply), order.history[bgetcol(board->info)]);
+    int numMoves = 0;
+    while ((moves[numMoves] = nextMove(&mp, board)))
+        numMoves++;
+    if (!numMoves)
+        return checked ? -SCORE_MATE + ply : 0;
+    SplitPoint sp = { parent, alpha, beta, 0, 0, {0} };
+    // Stays on this thread's stack until the taskwait, whoever runs the tasks
+    NnueAccumulators *acc = nnueCurrent();
+    int i;
+    for (i = 0; i < numMoves; ++i) {
+        if (splitAborted(&sp)) break;
+        // The eldest brother runs right away, the others wait for it
+        #pragma omp task if(i > 0) firstprivate(i) shared(sp, moves)
         {
-            int me = omp_get_thread_num();
-            Move undoM = boardMove(&boards[me], moves[i]);
-            // Update the move with its weight
-            int8_t weight = -alphaBeta(&boards[me], -beta, -(alpha - 1), curdepth);
-            moves[i] = msetweight(moves[i], weight);
-            undoMove(&boards[me], undoM);
-            // Update alpha if a better move was found at this depth. Critical
-            // to avoid race conditions with setting alpha and g_state
-            #pragma omp critical
-            if (weight > alpha)
+            Board child;
+            memcpy(&child, board, sizeof(Board));
+            int top = nnueEnter(acc);
+            Score a = __atomic_load_n(&sp.alpha, __ATOMIC_RELAXED);
+            Move childLine[MAX_PLY + 1];
+            // The ordering tables belong to whichever thread runs the task
+            order.played[ply] = moves[i];
+            Move undo = boardMove(&child, moves[i]);
+            Score weight;
+            if (i == 0)
+                weight = -ybwcSearch(&child, -beta, -a, depthleft - 1,
+                                     ply + 1, &sp, childLine);
+            else
             {
-                alpha = weight;
-                // Update global state in case search is interrupted
-                g_state.bestMove = moves[i];
+                weight = a + 1;
+                int r = 0;
+                if ((prune & PRUNE_LMR) && !checked
+                    && depthleft >= LMR_MIN_DEPTH && i >= LMR_MIN_MOVES
+                    && mgettaken(undo) == 0x7 && !mgetprom(undo)
+                    && !inCheck(&child))
+                    r = lateReduction(depthleft, i + 1, pvNode);
+                if (r > 0)
+                    weight = -ybwcSearch(&child, -a - 1, -a,
+                                         depthleft - 1 - r, ply + 1, &sp,
+                                         childLine);
+                if (weight > a && !splitAborted(&sp))
+                    weight = -ybwcSearch(&child, -a - 1, -a, depthleft - 1,
+                                         ply + 1, &sp, childLine);
+                if (weight > a && weight < beta && !splitAborted(&sp))
+                    weight = -ybwcSearch(&child, -beta, -a, depthleft - 1,
+                                         ply + 1, &sp, childLine);
             }
-            // If UCI_STOP, cancel remaining tasks
-            if (g_state.flags & UCI_STOP)
+            if (!splitAborted(&sp))
             {
-                #pragma omp cancel taskgroup
-                // Similar to break;
+                splitResult(&sp, weight, undo, childLine);
+                if (weight >= beta && mgettaken(undo) == 0x7)
+                    quietCutoff(undo, ply, depthleft);
             }
+            nnueLeave(top);
         }
-        // Sort the moves so we can find the best one!
-        qsort(moves, numMoves, sizeof(Move), compareMoveWeights);
     }
-    Move bestMove = 0;
-    if (numMoves) bestMove = moves[0];
-    for (i = 0; i < numMoves; ++i)
+    #pragma omp taskwait
+    // A stopped search returns garbage, don't let it reach the table
+    if (splitAborted(parent)) return 0;
+    if (sp.cutoff) {
+        ttStore(board->hash, sp.bestMove, scoreToTable(beta, ply), depthleft,
+                TT_LOWER);
+        return beta;
+    }
+    ttStore(board->hash, sp.bestMove, scoreToTable(sp.alpha, ply), depthleft,
+            sp.bestMove ? TT_EXACT : TT_UPPER);
+    if (sp.bestMove)
+        memcpy(line, sp.pv, sizeof(sp.pv));
+    return sp.alpha;
+}
+
+/* Root moves the next searches are limited to, none for every move */
+static Move searchMoves[MAX_MOVES_PER_POSITION];
+static int numSearchMoves = 0;
+
+void setSearchMoves(Move* moves, int numMoves)
+{
+    numSearchMoves = numMoves;
+    if (numMoves)
+        memcpy(searchMoves, moves, numMoves * sizeof(Move));
+}
+
+/*
+ * Drops the moves not given to setSearchMoves, comparing only the squares and
+ * promotion. Returns the number of moves left
+ */
+static int filterSearchMoves(Move* moves, int numMoves)
+{
+    if (!numSearchMoves) return numMoves;
+    int kept = 0;
+    for (int i = 0; i < numMoves; ++i)
+        for (int j = 0; j < numSearchMoves; ++j)
+            if (mgetsrc(moves[i]) == mgetsrc(searchMoves[j])
+                && mgetdst(moves[i]) == mgetdst(searchMoves[j])
+                && mgetprom(moves[i]) == mgetprom(searchMoves[j]))
+            {
+                moves[kept++] = moves[i];
+                break;
+            }
+    return kept;
+}
+
+/*
+ * Sorts moves from the highest score to the lowest, keeping the order of
+ * moves with equal scores so the last depth breaks the ties
+ */
+static void sortRootMoves(Move* moves, Score* scores, int numMoves)
+{
+    for (int i = 1; i < numMoves; ++i)
     {
-        printMove(moves[i]);
-        if (mgetweight(moves[i]) != mgetweight(bestMove))
-            break;
+        Move m = moves[i];
+        Score sc = scores[i];
+        int j;
+        for (j = i; j > 0 && scores[j - 1] < sc; --j)
+        {
+            moves[j] = moves[j - 1];
+            scores[j] = scores[j - 1];
+        }
+        moves[j] = m;
+        scores[j] = sc;
+    }
+}
+
+/* Results of searchRoot */
+enum RootResults {
+    ROOT_STOPPED = 0,
+    ROOT_EXACT,
+    ROOT_FAIL_LOW,
+    ROOT_FAIL_HIGH
+};
+
+/*
+ * Searches every root move of thread to depth inside the window alpha, beta.
+ * The first move gets the whole window and the others a null window, like in
+ * alphaBeta. When the score lands inside the window the moves are sorted by
+ * score, the best first, and the score and line of the best move are kept.
+ * The scores only replace the previous ones once the whole depth is done, so
+ * an interrupted search keeps the ordering of the last finished depth. A move
+ * failing high goes to the front for the next try. With split set, every
+ * move after the first is a task for the rest of the team and the tree below
+ * is searched with ybwcSearch.
+ * Returns one of RootResults
+ */
+static int searchRoot(SearchThread* thread, int depth, int split,
+        Score alpha, Score beta)
+{
+    Move moves[MAX_MOVES_PER_POSITION];
+    Score scores[MAX_MOVES_PER_POSITION];
+    memcpy(moves, thread->moves, thread->numMoves * sizeof(Move));
+    SplitPoint sp = { NULL, alpha, beta, 0, 0, {0} };
+    NnueAccumulators *acc = nnueCurrent();
+    int i;
+    for (i = 0; i < thread->numMoves; i++)
+    {
+        if (searchStopped() || sp.cutoff) break;
+        #pragma omp task if(split && i > 0) firstprivate(i) \
+            shared(sp, moves, scores, thread)
+        {
+            Board child;
+            memcpy(&child, &thread->board, sizeof(Board));
+            int top = nnueEnter(acc);
+            Score a = __atomic_load_n(&sp.alpha, __ATOMIC_RELAXED);
+            Move line[MAX_PLY + 1];
+            order.played[0] = moves[i];
+            boardMove(&child, moves[i]);
+            Score score;
+            if (split)
+            {
+                score = -ybwcSearch(&child, -(i ? a + 1 : beta), -a, depth, 1,
+                                    &sp, line);
+                if (i && score > a && score < beta && !splitAborted(&sp))
+                    score = -ybwcSearch(&child, -beta, -a, depth, 1, &sp,
+                                        line);
+            }
+            else
+            {
+                score = -alphaBeta(&child, -(i ? a + 1 : beta), -a, depth, 1);
+                if (i && score > a && score < beta && !searchStopped())
+                    score = -alphaBeta(&child, -beta, -a, depth, 1);
+                copyPv(line, 1);
+            }
+            if (!searchStopped())
+            {
+                scores[i] = score;
+                // Update global state in case search is interrupted
+                if (splitResult(&sp, score, moves[i], line)
+                    && thread->id == 0)
+                    g_state.bestMove = moves[i];
+            }
+            nnueLeave(top);
+        }
     }
-    int j;
-    for (j = 0; j < 0; ++j)
+    #pragma omp taskwait
+    if (searchStopped()) return ROOT_STOPPED;
+    if (sp.cutoff)
     {
-        fprintf(stderr, "%c%c%c%c weight: %d\n",
-                mgetsrc(moves[j]) % 8 + 'a',
-                mgetsrc(moves[j]) / 8 + '1',
-                mgetdst(moves[j]) % 8 + 'a',
-                mgetdst(moves[j]) / 8 + '1',
-                mgetweight(moves[j]));
+        // Try the move that failed high first next time
+        for (i = 0; thread->moves[i] != sp.bestMove; ++i);
+        for (; i > 0; --i)
+            thread->moves[i] = thread->moves[i - 1];
+        thread->moves[0] = sp.bestMove;
+        return ROOT_FAIL_HIGH;
     }
-    // If there are many bestMoves, pick one randomly
-    if (i - 1 > 0)
-        bestMove = moves[rand() % (i - 1)];
-    return bestMove;
+    if (!sp.bestMove) return ROOT_FAIL_LOW;
+    // Moves that failed low score alpha at best, below the best move
+    for (i = 0; i < thread->numMoves; ++i)
+        if (moves[i] != sp.bestMove && scores[i] >= sp.alpha)
+            scores[i] = sp.alpha - 1;
+    // Sort the moves so we can find the best one!
+    sortRootMoves(moves, scores, thread->numMoves);
+    memcpy(thread->moves, moves, thread->numMoves * sizeof(Move));
+    memcpy(thread->scores, scores, thread->numMoves * sizeof(Score));
+    memcpy(thread->pv, sp.pv, sizeof(sp.pv));
+    thread->score = sp.alpha;
+    thread->depth = depth;
+    return ROOT_EXACT;
 }
+/* timeNow() when the current search started, for the info lines */
+static uint64_t searchStart = 0;
 
-void perftRunThreaded(Board* board, PerftInfo* pi, uint8_t depth)
+/*
+ * Sends the gui an info line for a finished depth, nodes and nps come from the
+ * shared node count. Mates are given in moves, negative when getting mated
+ */
+static void printInfo(int depth, Score score, const Move* line)
 {
-    // Below code is very similar to perftRun
-    if (depth < 1)
+    uint64_t nodes = flushNodes();
+    uint64_t ms = timeNow() - searchStart;
+    const char* unit = "cp";
+    if (score >= SCORE_MATE_BOUND)
     {
-        pi->nodes = 1;
-        return;
+        unit = "mate";
+        score = (SCORE_MATE - score + 1) / 2;
+    }
+    else if (score <= -SCORE_MATE_BOUND)
+    {
+        unit = "mate";
+        score = -(SCORE_MATE + score) / 2;
     }
+    // Every move takes at most 6 characters with its space
+    char pvString[(MAX_PLY + 1) * 6 + 1] = "";
+    int n = 0;
+    for (int i = 0; line[i]; ++i)
+    {
+        sprintLANMove(pvString + n, line[i]);
+        n += strlen(pvString + n);
+    }
+    if (n) pvString[n - 1] = '\0';
+    if (dprintf(1, "info depth %d score %s %d nodes %lu nps %lu time %lu pv %s\n",
+                depth, unit, score, nodes, ms ? nodes * 1000 / ms : 0, ms,
+                pvString) < 0)
+        fprintf(stderr, "Error writing to stdout");
+}
 
-    // For depth == 1, it might not be worth threading
-    if (depth == 1)
+/*
+ * Lazy SMP: every thread runs its own iterative deepening over the whole tree
+ * and they only share the transposition table. Helpers on odd ids search one
+ * ply deeper than the main thread, so the threads are spread over two depths
+ * and store results the others will need next. With split set there is only
+ * the main thread, and the team helps it through the tasks of searchRoot.
+ * From ASPIRATION_MIN_DEPTH on, each depth starts with a narrow window around
+ * the score of the last one, and the side the score falls out of is widened
+ * until it lands inside
+ */
+static void iterativeDeepening(SearchThread* thread, int depth, int split)
+{
+    int curdepth;
+    uint64_t last = 0;
+    uint64_t before = 0;
+    // Nothing to search when mated or stalemated
+    if (!thread->numMoves) return;
+    for (curdepth = 1; curdepth <= depth; curdepth++)
+    {
+        // ponderhit restarts the clock of timeElapsed, so iterations are
+        // timed on their own
+        uint64_t start = timeNow();
+        Score alpha = -SCORE_INF;
+        Score beta = SCORE_INF;
+        Score delta = ASPIRATION_DELTA;
+        // Mate scores jump around too much for a window to help
+        if (thread->depth >= ASPIRATION_MIN_DEPTH
+            && thread->score > -SCORE_MATE_BOUND
+            && thread->score < SCORE_MATE_BOUND)
+        {
+            alpha = thread->score - delta;
+            beta = thread->score + delta;
+        }
+        int result;
+        while ((result = searchRoot(thread, curdepth + (thread->id & 1),
+                                    split, alpha, beta)) != ROOT_EXACT)
+        {
+            if (result == ROOT_STOPPED) return;
+            if (result == ROOT_FAIL_LOW)
+                alpha = alpha - delta > -SCORE_INF ? alpha - delta
+                                                   : -SCORE_INF;
+            else
+                beta = beta + delta < SCORE_INF ? beta + delta : SCORE_INF;
+            delta *= 2;
+        }
+        before = last;
+        last = timeNow() - start;
+        if (thread->id == 0)
+            printInfo(thread->depth, thread->score, thread->pv);
+        // The main thread gives up early if the next depth can't finish
+        if (thread->id == 0 && !timeNextIteration(last, before))
+            break;
+    }
+}
+
+Move findBestMove(Board* board, uint8_t depth)
+{
+    int numThreads = g_state.threads > 0 ? g_state.threads : 1;
+
+    // Setup independent variables for each thread
+    SearchThread* threads = malloc(numThreads * sizeof(SearchThread));
+    if (!threads)
+    {
+        fprintf(stderr, "Could not allocate %d search threads\n", numThreads);
+        return 0;
+    }
+    // MAX_MOVES_PER_POSITION*sizeof(Move) = 218 * 4 = 872 bytes
+    Move moves[MAX_MOVES_PER_POSITION];
+    uint8_t numMoves = genAllLegalMoves(board, moves);
+    numMoves = filterSearchMoves(moves, numMoves);
+    ttNewSearch();
+    __atomic_store_n(&searchDone, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&searchNodes, 0, __ATOMIC_RELAXED);
+    searchStart = timeNow();
+    int split = g_state.searchMode == SEARCH_YBWC;
+    #pragma omp parallel num_threads(numThreads)
+    {
+        // Implicit tasks of a parallel region never change threads, so the
+        // thread number is a safe index
+        int me = omp_get_thread_num();
+        SearchThread* thread = &threads[me];
+        memcpy(&thread->board, board, sizeof(Board));
+        if (nnueActive)
+            nnueAttach(&thread->nnue, thread->board.pieces);
+        memcpy(thread->moves, moves, numMoves * sizeof(Move));
+        thread->numMoves = numMoves;
+        thread->id = me;
+        thread->depth = 0;
+        thread->pv[0] = 0;
+        memset(&order, 0, sizeof(order));
+        // Under YBWC the other threads wait at the end of the region and run
+        // the tasks the main thread makes
+        if (!split || me == 0)
+            iterativeDeepening(thread, depth, split);
+        // The main thread decides when the search is over
+        if (me == 0)
+            __atomic_store_n(&searchDone, 1, __ATOMIC_RELAXED);
+        // Every task is done after the barrier, so no more nodes get counted
+        #pragma omp barrier
+        flushNodes();
+        nnueDetach();
+    }
+    // The moves stay in the order of the last finished depth, or as generated
+    // if not even the first one finished
+    Move bestMove = numMoves ? threads[0].moves[0] : 0;
+    free(threads);
+    return bestMove;
+}
+
+/* Adds the totals of from to to */
+static void perftAdd(PerftInfo* to, const PerftInfo* from)
+{
+    to->nodes += from->nodes;
+    to->captures += from->captures;
+    to->enpassants += from->enpassants;
+    to->castles += from->castles;
+    to->promotions += from->promotions;
+    to->checks += from->checks;
+    to->checkmates += from->checkmates;
+}
+
+/*
+ * Runs perftRun on every move of board as its own task, and the same for the
+ * moves below them until split plies have been split. Each task plays its
+ * move on its own copy of the board and counts into its own PerftInfo, the
+ * totals are added up once all of them are done. Idle threads pick up tasks
+ * from any level, so large subtrees don't hold up the rest
+ */
+static void perftSplit(Board* board, PerftInfo* pi, int depth, int split)
+{
+    if (split < 1 || depth < 2)
     {
         perftRun(board, pi, depth);
         return;
     }
-
     Move movelist[MAX_MOVES_PER_POSITION];
+    PerftInfo results[MAX_MOVES_PER_POSITION];
     int n_moves = genAllLegalMoves(board, movelist);
-    int i;
+    memset(results, 0, n_moves * sizeof(PerftInfo));
+    for (int i = 0; i < n_moves; ++i)
+    {
+        #pragma omp task firstprivate(i) shared(movelist, results)
+        {
+            Board child;
+            memcpy(&child, board, sizeof(Board));
+            boardMove(&child, movelist[i]);
+            perftSplit(&child, &results[i], depth - 1, split - 1);
+        }
+    }
+    #pragma omp taskwait
+    for (int i = 0; i < n_moves; ++i)
+        perftAdd(pi, &results[i]);
+}
 
-    PerftInfo pilist[NUM_THREADS] = {0};
-    Board boards[NUM_THREADS];
-    for (i = 0; i < NUM_THREADS; i++)
-        memcpy(boards+i, board, sizeof(Board));
+void perftRunThreaded(Board* board, PerftInfo* pi, uint8_t depth)
+{
+    int numThreads = g_state.threads > 0 ? g_state.threads : 1;
+    PerftInfo total = {0};
+    #pragma omp parallel num_threads(numThreads)
+    #pragma omp single
+    perftSplit(board, &total, depth, g_state.perftSplit);
+    perftAdd(pi, &total);
+}
 
-#pragma omp taskloop untied default(shared)
-    for (i = 0; i < n_moves; ++i)
+/* Perft results by position and depth, NULL until the first perftFast */
+static PerftEntry* perftTable = NULL;
+
+/*
+ * Counts the leaves below board to depth, at least 1. Every position is
+ * looked up in the perft table first, and stored once counted. A slot only
+ * holds the last position stored in it
+ */
+static uint64_t perftCount(Board* board, int depth)
+{
+    Move movelist[MAX_MOVES_PER_POSITION];
+    PerftEntry* entry = perftTable
+        ? perftTable + (board->hash & (PERFT_TABLE_SIZE - 1)) : NULL;
+    if (entry && depth > 1)
     {
-        int me = omp_get_thread_num();
-        movelist[i] = boardMove(&boards[me], movelist[i]);
-        perftRun(&boards[me], &pilist[me], depth - 1);
-        undoMove(&boards[me], movelist[i]);
+        uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+        uint64_t key = __atomic_load_n(&entry->key, __ATOMIC_RELAXED);
+        if ((key ^ data) == board->hash && (data & 0xff) == (uint64_t)depth)
+            return data >> 8;
     }
+    int n_moves = genAllLegalMoves(board, movelist);
+    // Bulk counting, the leaves don't need to be played
+    if (depth == 1) return n_moves;
+    uint64_t nodes = 0;
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        nodes += perftCount(board, depth - 1);
+        undoMove(board, undo);
+    }
+    if (entry)
+    {
+        uint64_t data = (nodes << 8) | depth;
+        __atomic_store_n(&entry->key, board->hash ^ data, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+    }
+    return nodes;
+}
 
-    // Combine pi results
-    for (i=0; i<NUM_THREADS; i++)
+/*
+ * perftCount split into tasks like perftSplit, with a count for each task
+ */
+static uint64_t perftCountSplit(Board* board, int depth, int split)
+{
+    if (split < 1 || depth < 2)
+        return perftCount(board, depth);
+    Move movelist[MAX_MOVES_PER_POSITION];
+    uint64_t counts[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
     {
-        pi->nodes += pilist[i].nodes;
-        pi->captures += pilist[i].captures;
-        pi->enpassants += pilist[i].enpassants;
-        pi->castles += pilist[i].castles;
-        pi->promotions += pilist[i].promotions;
-        pi->checks += pilist[i].checks;
-        pi->checkmates += pilist[i].checkmates;
+        #pragma omp task firstprivate(i) shared(movelist, counts)
+        {
+            Board child;
+            memcpy(&child, board, sizeof(Board));
+            boardMove(&child, movelist[i]);
+            counts[i] = perftCountSplit(&child, depth - 1, split - 1);
+        }
     }
+    #pragma omp taskwait
+    uint64_t nodes = 0;
+    for (int i = 0; i < n_moves; ++i)
+        nodes += counts[i];
+    return nodes;
+}
+
+/*
+ * Allocates the perft table or empties it. Without it every subtree is just
+ * counted again. It starts empty every time so repeated runs take the same
+ * time
+ */
+static void perftTableReset()
+{
+    if (!perftTable)
+        perftTable = calloc(PERFT_TABLE_SIZE, sizeof(PerftEntry));
+    else
+        memset(perftTable, 0, PERFT_TABLE_SIZE * sizeof(PerftEntry));
+}
+
+uint64_t perftFast(Board* board, uint8_t depth)
+{
+    if (depth < 1) return 1;
+    if (depth == 1) return perftCount(board, 1);
+    perftTableReset();
+
+    int numThreads = g_state.threads > 0 ? g_state.threads : 1;
+    uint64_t nodes = 0;
+    #pragma omp parallel num_threads(numThreads)
+    #pragma omp single
+    nodes = perftCountSplit(board, depth, g_state.perftSplit);
+    return nodes;
+}
+
+int perftDivide(Board* board, uint8_t depth, Move* moves, uint64_t* counts)
+{
+    int n_moves = genAllLegalMoves(board, moves);
+    if (depth < 1) return 0;
+    perftTableReset();
+    int numThreads = g_state.threads > 0 ? g_state.threads : 1;
+    // The root moves are the first ply of the split
+    int split = g_state.perftSplit > 0 ? g_state.perftSplit - 1 : 0;
+    #pragma omp parallel num_threads(numThreads)
+    #pragma omp single
+    {
+        for (int i = 0; i < n_moves; ++i)
+        {
+            #pragma omp task firstprivate(i)
+            {
+                Board child;
+                memcpy(&child, board, sizeof(Board));
+                boardMove(&child, moves[i]);
+                counts[i] = depth > 1
+                    ? perftCountSplit(&child, depth - 1, split) : 1;
+            }
+        }
+    }
+    return n_moves;
 }
 
 void perftRun(Board* board, PerftInfo* pi, uint8_t depth)
@@ -199,9 +1116,7 @@ void perftRun(Board* board, PerftInfo* pi, uint8_t depth)
         pi->nodes += n_moves;
 
         int enemyColor = (bgetcol(board->info) == _WHITE) ? BLACK : WHITE;
-        uint64_t enemyPieces = 0UL;
-        for (i = 0; i < 6; ++i)
-            enemyPieces |= board->pieces[enemyColor + i];
+        uint64_t enemyPieces = board->occupancy[enemyColor == BLACK];
 
         for (i = 0; i < n_moves; ++i)
         {
@@ -219,6 +1134,10 @@ void perftRun(Board* board, PerftInfo* pi, uint8_t depth)
                 pi->captures++;
             }
 
+            // Promotions
+            if (mgetprom(movelist[i]))
+                pi->promotions++;
+
             // En passants
             if ((mgetpiece(movelist[i]) == PAWN) && bgetenp(board->info)
                 && (mgetdst(movelist[i]) == bgetenpsquare(board->info)))
@@ -284,13 +1203,13 @@ void perftRun(Board* board, PerftInfo* pi, uint8_t depth)
 void printPerft(PerftInfo pi)
 {
     #ifdef CSV
-    printf("%d,%ld,%ld,%ld,%ld,%ld,%ld\n", NUM_THREADS,
-           pi.nodes, pi.captures, pi.enpassants, pi.castles, pi.checks,
-           pi.checkmates);
+    printf("%d,%ld,%ld,%ld,%ld,%ld,%ld,%ld\n", g_state.threads,
+           pi.nodes, pi.captures, pi.enpassants, pi.castles, pi.promotions,
+           pi.checks, pi.checkmates);
     #else
-    printf("\nNodes: %ld\nCaptures: %ld\nEn Passants: %ld\nCastles: %ld\nChecks: "
-           "%ld\nCheckmates: %ld\n",
-           pi.nodes, pi.captures, pi.enpassants, pi.castles, pi.checks,
-           pi.checkmates);
+    printf("\nNodes: %ld\nCaptures: %ld\nEn Passants: %ld\nCastles: %ld\n"
+           "Promotions: %ld\nChecks: %ld\nCheckmates: %ld\n",
+           pi.nodes, pi.captures, pi.enpassants, pi.castles, pi.promotions,
+           pi.checks, pi.checkmates);
     #endif
 }
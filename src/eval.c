@@ -0,0 +1,363 @@
+#include <stdint.h>
+
+#include "eval.h"
+#include "board.h"
+#include "bitHelpers.h"
+
+int16_t psqtMg[12][64];
+int16_t psqtEg[12][64];
+
+const uint8_t phaseWeights[12] = {0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0};
+
+/* Pawn structure terms. Passed pawn bonuses are indexed by rank counted from
+ * the side of the pawn
+ */
+static const int16_t passedMg[8] = {0, 5, 10, 15, 25, 45, 70, 0};
+static const int16_t passedEg[8] = {0, 10, 20, 35, 60, 95, 140, 0};
+#define DOUBLED_MG  -10
+#define DOUBLED_EG  -25
+#define ISOLATED_MG -10
+#define ISOLATED_EG -15
+#define BACKWARD_MG  -8
+#define BACKWARD_EG -10
+
+/* Mobility terms for KNIGHT, BISHOP, ROOK and QUEEN, indexed by piece. Each
+ * square a piece can go to past mobilityCenter is worth the weight, fewer
+ * cost it
+ */
+static const int8_t mobilityCenter[5] = {0, 4, 7, 7, 14};
+static const int8_t mobilityMg[5] = {0, 4, 5, 2, 1};
+static const int8_t mobilityEg[5] = {0, 4, 5, 4, 2};
+
+/* How much a piece adds to the attack on the enemy king for each square of
+ * the king zone it hits, and the share of the total that counts once that
+ * many pieces take part, in percent
+ */
+static const int8_t kingAttackWeight[5] = {0, 2, 2, 3, 5};
+static const int8_t kingAttackScale[8] = {0, 0, 50, 75, 88, 94, 97, 99};
+
+/* Pawn masks indexed by color (_WHITE or _BLACK) and square, built by
+ * initEval:
+ * - frontFile is every square ahead of the square on its file
+ * - passedSpan adds the files on either side, enemy pawns there stop a pawn
+ *   from being passed
+ * - supportSpan is the squares on the files on either side that are level
+ *   with or behind the square, friendly pawns there can still defend it
+ */
+static uint64_t frontFile[2][64];
+static uint64_t passedSpan[2][64];
+static uint64_t supportSpan[2][64];
+static uint64_t adjacentFiles[8];
+
+/* Pawn hash table of this thread */
+static __thread PawnEntry pawnTable[PAWN_TABLE_SIZE];
+
+/* Material of PAWN, KNIGHT, BISHOP, ROOK, QUEEN and KING */
+static const int16_t materialMg[6] = {82, 337, 365, 477, 1025, 0};
+static const int16_t materialEg[6] = {94, 281, 297, 512, 936, 0};
+
+/*
+ * Tables from PeSTO by Ronald Friederich. They are laid out the way a board
+ * is printed, a8 first and h1 last, for white's pieces
+ */
+static const int16_t tableMg[6][64] = {
+    { // Pawn
+          0,   0,   0,   0,   0,   0,   0,   0,
+         98, 134,  61,  95,  68, 126,  34, -11,
+         -6,   7,  26,  31,  65,  56,  25, -20,
+        -14,  13,   6,  21,  23,  12,  17, -23,
+        -27,  -2,  -5,  12,  17,   6,  10, -25,
+        -26,  -4,  -4, -10,   3,   3,  33, -12,
+        -35,  -1, -20, -23, -15,  24,  38, -22,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    { // Knight
+       -167, -89, -34, -49,  61, -97, -15,-107,
+        -73, -41,  72,  36,  23,  62,   7, -17,
+        -47,  60,  37,  65,  84, 129,  73,  44,
+         -9,  17,  19,  53,  37,  69,  18,  22,
+        -13,   4,  16,  13,  28,  19,  21,  -8,
+        -23,  -9,  12,  10,  19,  17,  25, -16,
+        -29, -53, -12,  -3,  -1,  18, -14, -19,
+       -105, -21, -58, -33, -17, -28, -19, -23,
+    },
+    { // Bishop
+        -29,   4, -82, -37, -25, -42,   7,  -8,
+        -26,  16, -18, -13,  30,  59,  18, -47,
+        -16,  37,  43,  40,  35,  50,  37,  -2,
+         -4,   5,  19,  50,  37,  37,   7,  -2,
+         -6,  13,  13,  26,  34,  12,  10,   4,
+          0,  15,  15,  15,  14,  27,  18,  10,
+          4,  15,  16,   0,   7,  21,  33,   1,
+        -33,  -3, -14, -21, -13, -12, -39, -21,
+    },
+    { // Rook
+         32,  42,  32,  51,  63,   9,  31,  43,
+         27,  32,  58,  62,  80,  67,  26,  44,
+         -5,  19,  26,  36,  17,  45,  61,  16,
+        -24, -11,   7,  26,  24,  35,  -8, -20,
+        -36, -26, -12,  -1,   9,  -7,   6, -23,
+        -45, -25, -16, -17,   3,   0,  -5, -33,
+        -44, -16, -20,  -9,  -1,  11,  -6, -71,
+        -19, -13,   1,  17,  16,   7, -37, -26,
+    },
+    { // Queen
+        -28,   0,  29,  12,  59,  44,  43,  45,
+        -24, -39,  -5,   1, -16,  57,  28,  54,
+        -13, -17,   7,   8,  29,  56,  47,  57,
+        -27, -27, -16, -16,  -1,  17,  -2,   1,
+         -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+        -14,   2, -11,  -2,  -5,   2,  14,   5,
+        -35,  -8,  11,   2,   8,  15,  -3,   1,
+         -1, -18,  -9,  10, -15, -25, -31, -50,
+    },
+    { // King
+        -65,  23,  16, -15, -56, -34,   2,  13,
+         29,  -1, -20,  -7,  -8,  -4, -38, -29,
+         -9,  24,   2, -16, -20,   6,  22, -22,
+        -17, -20, -12, -27, -30, -25, -14, -36,
+        -49,  -1, -27, -39, -46, -44, -33, -51,
+        -14, -14, -22, -46, -44, -30, -15, -27,
+          1,   7,  -8, -64, -43, -16,   9,   8,
+        -15,  36,  12, -54,   8, -28,  24,  14,
+    },
+};
+
+static const int16_t tableEg[6][64] = {
+    { // Pawn
+          0,   0,   0,   0,   0,   0,   0,   0,
+        178, 173, 158, 134, 147, 132, 165, 187,
+         94, 100,  85,  67,  56,  53,  82,  84,
+         32,  24,  13,   5,  -2,   4,  17,  17,
+         13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+          4,   7,  -6,   1,   0,  -5,  -1,  -8,
+         13,   8,   8,  10,  13,   0,   2,  -7,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    { // Knight
+        -58, -38, -13, -28, -31, -27, -63, -99,
+        -25,  -8, -25,  -2,  -9, -25, -24, -52,
+        -24, -20,  10,   9,  -1,  -9, -19, -41,
+        -17,   3,  22,  22,  22,  11,   8, -18,
+        -18,  -6,  16,  25,  16,  17,   4, -18,
+        -23,  -3,  -1,  15,  10,  -3, -20, -22,
+        -42, -20, -10,  -5,  -2, -20, -23, -44,
+        -29, -51, -23, -15, -22, -18, -50, -64,
+    },
+    { // Bishop
+        -14, -21, -11,  -8,  -7,  -9, -17, -24,
+         -8,  -4,   7, -12,  -3, -13,  -4, -14,
+          2,  -8,   0,  -1,  -2,   6,   0,   4,
+         -3,   9,  12,   9,  14,  10,   3,   2,
+         -6,   3,  13,  19,   7,  10,  -3,  -9,
+        -12,  -3,   8,  10,  13,   3,  -7, -15,
+        -14, -18,  -7,  -1,   4,  -9, -15, -27,
+        -23,  -9, -23,  -5,  -9, -16,  -5, -17,
+    },
+    { // Rook
+         13,  10,  18,  15,  12,  12,   8,   5,
+         11,  13,  13,  11,  -3,   3,   8,   3,
+          7,   7,   7,   5,   4,  -3,  -5,  -3,
+          4,   3,  13,   1,   2,   1,  -1,   2,
+          3,   5,   8,   4,  -5,  -6,  -8, -11,
+         -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+         -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+         -9,   2,   3,  -1,  -5, -13,   4, -20,
+    },
+    { // Queen
+         -9,  22,  22,  27,  27,  19,  10,  20,
+        -17,  20,  32,  41,  58,  25,  30,   0,
+        -20,   6,   9,  49,  47,  35,  19,   9,
+          3,  22,  24,  45,  57,  40,  57,  36,
+        -18,  28,  19,  47,  31,  34,  39,  23,
+        -16, -27,  15,   6,   9,  17,  10,   5,
+        -22, -23, -30, -16, -16, -23, -36, -32,
+        -33, -28, -22, -43,  -5, -32, -20, -41,
+    },
+    { // King
+        -74, -35, -18, -18, -11,  15,   4, -17,
+        -12,  17,  14,  17,  17,  38,  23,  11,
+         10,  17,  23,  15,  20,  45,  44,  13,
+         -8,  22,  24,  27,  26,  33,  26,   3,
+        -18,  -4,  21,  24,  27,  23,   9, -11,
+        -19,  -3,  11,  21,  23,  16,   7,  -9,
+        -27, -11,   4,  13,  14,   4,  -5, -17,
+        -53, -34, -21, -11, -28, -14, -24, -43,
+    },
+};
+
+void initEval()
+{
+    for (int piece = PAWN; piece <= KING; ++piece)
+    {
+        for (int square = 0; square < 64; ++square)
+        {
+            // Square indexes start at a1, the tables at a8. Black sees the
+            // table from the other side of the board
+            int white = square ^ 56;
+            int black = square;
+            psqtMg[piece + WHITE][square] = materialMg[piece]
+                                          + tableMg[piece][white];
+            psqtEg[piece + WHITE][square] = materialEg[piece]
+                                          + tableEg[piece][white];
+            psqtMg[piece + BLACK][square] = -(materialMg[piece]
+                                          + tableMg[piece][black]);
+            psqtEg[piece + BLACK][square] = -(materialEg[piece]
+                                          + tableEg[piece][black]);
+        }
+    }
+    for (int file = 0; file < 8; ++file)
+        adjacentFiles[file] = (file > 0 ? FILELIST[file - 1] : 0)
+                            | (file < 7 ? FILELIST[file + 1] : 0);
+    for (int square = 0; square < 64; ++square)
+    {
+        int rank = square >> 3;
+        uint64_t ahead[2] = {0, 0};
+        uint64_t behind[2] = {0, 0};
+        for (int r = 0; r < 8; ++r)
+        {
+            ahead[_WHITE] |= r > rank ? RANK[r] : 0;
+            ahead[_BLACK] |= r < rank ? RANK[r] : 0;
+            behind[_WHITE] |= r <= rank ? RANK[r] : 0;
+            behind[_BLACK] |= r >= rank ? RANK[r] : 0;
+        }
+        for (int color = _WHITE; color <= _BLACK; ++color)
+        {
+            uint64_t files = FILELIST[square & 7];
+            uint64_t sides = adjacentFiles[square & 7];
+            frontFile[color][square] = ahead[color] & files;
+            passedSpan[color][square] = ahead[color] & (files | sides);
+            supportSpan[color][square] = behind[color] & sides;
+        }
+    }
+}
+
+/*
+ * Adds the pawn structure terms of the pawns ours of color to mg and eg,
+ * from the side of color
+ */
+static void scoreSide(uint64_t ours, uint64_t theirs, int color,
+                      int *mg, int *eg)
+{
+    for (uint64_t pawns = ours; pawns; pawns &= pawns - 1)
+    {
+        int square = bitScanForward(pawns);
+        int rank = color == _WHITE ? square >> 3 : 7 - (square >> 3);
+        if (ours & frontFile[color][square])
+        {
+            // Only the front pawn of a file can be passed
+            *mg += DOUBLED_MG;
+            *eg += DOUBLED_EG;
+        }
+        else if (!(theirs & passedSpan[color][square]))
+        {
+            *mg += passedMg[rank];
+            *eg += passedEg[rank];
+        }
+        if (!(ours & adjacentFiles[square & 7]))
+        {
+            *mg += ISOLATED_MG;
+            *eg += ISOLATED_EG;
+        }
+        else if (rank < 7 && !(ours & supportSpan[color][square]))
+        {
+            // No pawn can come up to defend it, and an enemy pawn keeps it
+            // from stepping up to them
+            int stop = color == _WHITE ? square + 8 : square - 8;
+            if (pawnAttacks[color][stop] & theirs)
+            {
+                *mg += BACKWARD_MG;
+                *eg += BACKWARD_EG;
+            }
+        }
+    }
+}
+
+/*
+ * Returns every square attacked by the pawns of color
+ */
+static inline uint64_t pawnAttackSpan(uint64_t pawns, int color)
+{
+    if (color == _WHITE)
+        return ((pawns << 9) & ~AFILE) | ((pawns << 7) & ~HFILE);
+    return ((pawns >> 7) & ~AFILE) | ((pawns >> 9) & ~HFILE);
+}
+
+void evaluatePieces(Board *board, int *mg, int *eg)
+{
+    uint64_t occupancy = board->occupied;
+    int sign[2] = {1, -1};
+    for (int color = _WHITE; color <= _BLACK; ++color)
+    {
+        int us = color ? BLACK : WHITE;
+        int them = us ^ BLACK;
+        // Squares guarded by enemy pawns don't count as mobility
+        uint64_t safe = ~board->occupancy[color]
+                      & ~pawnAttackSpan(board->pieces[PAWN + them], color ^ 1);
+        int king = bitScanForward(board->pieces[KING + them]);
+        uint64_t zone = kingAttacks[king] | board->pieces[KING + them];
+        int attackers = 0;
+        int attackWeight = 0;
+        int mobMg = 0;
+        int mobEg = 0;
+        for (int piece = KNIGHT; piece <= QUEEN; ++piece)
+        {
+            uint64_t pieces = board->pieces[piece + us];
+            for (; pieces; pieces &= pieces - 1)
+            {
+                int square = bitScanForward(pieces);
+                uint64_t attacks;
+                if (piece == KNIGHT)
+                    attacks = knightAttacks[square];
+                else if (piece == BISHOP)
+                    attacks = magicLookupBishop(occupancy, square);
+                else if (piece == ROOK)
+                    attacks = magicLookupRook(occupancy, square);
+                else
+                    attacks = magicLookupBishop(occupancy, square)
+                            | magicLookupRook(occupancy, square);
+                int moves = getNumBits(attacks & safe)
+                          - mobilityCenter[piece];
+                mobMg += moves * mobilityMg[piece];
+                mobEg += moves * mobilityEg[piece];
+                uint64_t hits = attacks & zone;
+                if (hits)
+                {
+                    attackers++;
+                    attackWeight += kingAttackWeight[piece]
+                                  * getNumBits(hits);
+                }
+            }
+        }
+        if (attackers > 7) attackers = 7;
+        // A lone attacker can't do much, king safety only counts in the
+        // middlegame
+        mobMg += attackWeight * kingAttackScale[attackers] / 20;
+        *mg += sign[color] * mobMg;
+        *eg += sign[color] * mobEg;
+    }
+}
+
+void scorePawns(Board *board, PawnEntry *entry)
+{
+    uint64_t white = board->pieces[PAWN + WHITE];
+    uint64_t black = board->pieces[PAWN + BLACK];
+    int mg[2] = {0, 0};
+    int eg[2] = {0, 0};
+    scoreSide(white, black, _WHITE, &mg[_WHITE], &eg[_WHITE]);
+    scoreSide(black, white, _BLACK, &mg[_BLACK], &eg[_BLACK]);
+    entry->key = board->pawnHash;
+    entry->mg = mg[_WHITE] - mg[_BLACK];
+    entry->eg = eg[_WHITE] - eg[_BLACK];
+}
+
+void evaluatePawns(Board *board, int *mg, int *eg)
+{
+    PawnEntry *entry = &pawnTable[board->pawnHash & (PAWN_TABLE_SIZE - 1)];
+    // The empty entries have key 0, which is also the key of no pawns at
+    // all, and 0 is the right score for that
+    if (entry->key != board->pawnHash)
+        scorePawns(board, entry);
+    *mg += entry->mg;
+    *eg += entry->eg;
+}
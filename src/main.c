@@ -5,10 +5,13 @@
 #include <string.h>
 #include <time.h>
 
+#include "bench.h"
 #include "bitHelpers.h"
 #include "board.h"
+#include "engine.h"
 #include "tests.h"
 #include "magic.h"
+#include "tt.h"
 #include "uci.h"
 
 /* Global variable across all files that include uci.h */
@@ -46,6 +49,24 @@ static int parse_opt (int key, char *arg, struct argp_state *state)
             break;
         case 501:
             exit(computeMagic());
+        case 502:
+            {
+                const char *path = arg ? arg : BENCH_FILE;
+                FILE *epd = fopen(path, "r");
+                if (!epd)
+                {
+                    fprintf(stderr, "Could not open bench file %s\n", path);
+                    exit(1);
+                }
+                // Run from a team like uci commands, so the perft and search
+                // teams are nested the same way
+                #pragma omp parallel
+                #pragma omp single
+                result = runBench(epd, NULL);
+                fclose(epd);
+                // Mismatched perft counts fail make bench
+                exit(result != 0);
+            }
     }
     return 0;
 }
@@ -55,15 +76,37 @@ int main(int argc, char** argv)
    /* Lefoux cli preamble */
 #ifdef _OPENMP
     fprintf( stderr, "OpenMP is supported -- version = %d\n", _OPENMP );
-    fprintf( stderr, "NUM_THREADS = %d\n", NUM_THREADS);
+    fprintf( stderr, "Threads = %d\n", NUM_THREADS);
     fprintf( stderr, "Lefoux " LEFOUX_VERSION "\n");
 #else
     fprintf( stderr, "No OpenMP support!\n" );
     return 1;
 #endif
 
+#if USE_PEXT
+    if (!__builtin_cpu_supports("bmi2"))
+    {
+        fprintf( stderr, "This build uses pext but the cpu has no BMI2, "
+                         "build without make pext\n");
+        return 1;
+    }
+#endif
+
     srand(time(NULL));
-    omp_set_num_threads(NUM_THREADS);
+    omp_set_num_threads(UCI_THREADS);
+    // Search and perft teams are started from inside the command team
+    omp_set_max_active_levels(2);
+    g_state.threads = NUM_THREADS;
+    g_state.pruning = PRUNE_ALL;
+    g_state.perftSplit = PERFT_SPLIT_DEPTH;
+    initBoard();
+    initSearch();
+    fprintf( stderr, "PEXT = %d\n", USE_PEXT);
+    fprintf( stderr, "POPCNT = %d\n", HW_POPCOUNT);
+    if (!HW_POPCOUNT && __builtin_cpu_supports("popcnt"))
+        fprintf( stderr, "This cpu has popcnt, use make native for a faster "
+                         "build\n");
+    if (ttResize(TT_DEFAULT_MB)) return 1;
 
     /* Command line args */
     struct flags flags;
@@ -72,6 +115,9 @@ int main(int argc, char** argv)
         {"fen", 'f', "STRING", 0, "start board with position", 0},
         {"test", 500, 0, 0, "Run unit tests", 0},
         {"magic", 501, 0, 0, "Compute magic numbers for Rooks and Bishops", 0},
+        {"bench", 502, "FILE", OPTION_ARG_OPTIONAL,
+            "Run the positions of an EPD file, " BENCH_FILE " by default, "
+            "and print nodes, time, nps and the signature", 0},
         { 0 }
     };
     struct argp argp = {options, parse_opt, 0, "Multithreaded chess engine.",
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>     // memcpy()
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NNUE_X86 1
+#else
+#define NNUE_X86 0
+#endif
+
+#include "nnue.h"
+#include "bitHelpers.h"
+#include "engine.h"     // SCORE_MATE_BOUND
+
+NnueNetwork nnueNet;
+int nnueActive = 0;
+__thread NnueStack *nnueStack = NULL;
+
+/* Network being read by nnueLoad, only copied over nnueNet once it is whole */
+static NnueNetwork loading;
+
+/*
+ * The feature helpers are defined inline in nnue.h so they are inlined into
+ * the board helpers. These declarations emit one out of line copy for calls
+ * the compiler chooses not to inline
+ */
+extern inline int nnueFeature(int perspective, int piece, int square);
+extern inline void nnueAddFeature(int16_t acc[2][NNUE_HIDDEN], int piece,
+                                  int square);
+extern inline void nnueRemoveFeature(int16_t acc[2][NNUE_HIDDEN], int piece,
+                                     int square);
+extern inline void nnueMoveFeature(int16_t acc[2][NNUE_HIDDEN], int piece,
+                                   int src, int dst);
+extern inline NnueAccumulators *nnueCurrent();
+extern inline NnueAccumulators *nnuePush();
+extern inline void nnuePop();
+
+/*
+ * Dense layer kernels. Each one sets output[j] to the bias of neuron j plus
+ * the dot product of input with its weights. Inputs are clipped to
+ * [0, NNUE_CLIP], so the 16 bit pair sums of maddubs can't saturate and
+ * every kernel gives the same result as the scalar one
+ */
+static void denseScalar(const int8_t *input, int32_t *output)
+{
+    for (int j = 0; j < NNUE_L1; ++j)
+    {
+        int32_t sum = nnueNet.l1Bias[j];
+        for (int i = 0; i < 2 * NNUE_HIDDEN; ++i)
+            sum += input[i] * nnueNet.l1Weights[j][i];
+        output[j] = sum;
+    }
+}
+
+#if NNUE_X86
+__attribute__((target("sse4.1")))
+static void denseSse41(const int8_t *input, int32_t *output)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int j = 0; j < NNUE_L1; ++j)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i += 16)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(input + i));
+            __m128i w = _mm_loadu_si128(
+                    (const __m128i *)(nnueNet.l1Weights[j] + i));
+            __m128i pairs = _mm_maddubs_epi16(in, w);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        output[j] = nnueNet.l1Bias[j] + _mm_cvtsi128_si32(sum);
+    }
+}
+
+__attribute__((target("avx2")))
+static void denseAvx2(const int8_t *input, int32_t *output)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int j = 0; j < NNUE_L1; ++j)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i += 32)
+        {
+            __m256i in = _mm256_loadu_si256((const __m256i *)(input + i));
+            __m256i w = _mm256_loadu_si256(
+                    (const __m256i *)(nnueNet.l1Weights[j] + i));
+            __m256i pairs = _mm256_maddubs_epi16(in, w);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                     _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+        output[j] = nnueNet.l1Bias[j] + _mm_cvtsi128_si32(half);
+    }
+}
+#endif
+
+static void (*denseKernel)(const int8_t *, int32_t *) = denseScalar;
+
+int nnueSetKernel(int kernel)
+{
+    switch (kernel) {
+        case NNUE_SCALAR:
+            denseKernel = denseScalar;
+            return 1;
+#if NNUE_X86
+        case NNUE_SSE41:
+            if (!__builtin_cpu_supports("sse4.1")) return 0;
+            denseKernel = denseSse41;
+            return 1;
+        case NNUE_AVX2:
+            if (!__builtin_cpu_supports("avx2")) return 0;
+            denseKernel = denseAvx2;
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+int nnueBestKernel()
+{
+#if NNUE_X86
+    if (__builtin_cpu_supports("avx2")) return NNUE_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return NNUE_SSE41;
+#endif
+    return NNUE_SCALAR;
+}
+
+/*
+ * Reads count little endian items of size bytes into dest, in host order.
+ * Returns 1 if all of them were read
+ */
+static int readAll(FILE *f, void *dest, size_t size, size_t count)
+{
+    if (fread(dest, size, count, f) != count)
+        return 0;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (size == 2)
+            ((uint16_t *)dest)[i] = __builtin_bswap16(((uint16_t *)dest)[i]);
+        else if (size == 4)
+            ((uint32_t *)dest)[i] = __builtin_bswap32(((uint32_t *)dest)[i]);
+    }
+#endif
+    return 1;
+}
+
+int nnueLoad(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "Could not open network file %s\n", path);
+        return 1;
+    }
+    uint32_t header[4];
+    int ok = readAll(f, header, sizeof(uint32_t), 4)
+          && header[0] == NNUE_MAGIC && header[1] == NNUE_VERSION
+          && header[2] == NNUE_HIDDEN && header[3] == NNUE_L1
+          && readAll(f, loading.featureBias, sizeof(int16_t), NNUE_HIDDEN)
+          && readAll(f, loading.featureWeights, sizeof(int16_t),
+                     NNUE_INPUTS * NNUE_HIDDEN)
+          && readAll(f, loading.l1Bias, sizeof(int32_t), NNUE_L1)
+          && readAll(f, loading.l1Weights, sizeof(int8_t),
+                     NNUE_L1 * 2 * NNUE_HIDDEN)
+          && readAll(f, &loading.outBias, sizeof(int32_t), 1)
+          && readAll(f, loading.outWeights, sizeof(int8_t), NNUE_L1)
+          && fgetc(f) == EOF;
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "%s is not a %dx%d network\n", path, NNUE_HIDDEN,
+                NNUE_L1);
+        return 1;
+    }
+    memcpy(&nnueNet, &loading, sizeof(NnueNetwork));
+    nnueSetKernel(nnueBestKernel());
+    nnueActive = 1;
+    return 0;
+}
+
+void nnueDisable()
+{
+    nnueActive = 0;
+}
+
+void nnueRefresh(int16_t acc[2][NNUE_HIDDEN], const uint64_t pieces[12])
+{
+    memcpy(acc[0], nnueNet.featureBias, sizeof(nnueNet.featureBias));
+    memcpy(acc[1], nnueNet.featureBias, sizeof(nnueNet.featureBias));
+    for (int piece = 0; piece < 12; ++piece)
+        for (uint64_t bb = pieces[piece]; bb; bb &= bb - 1)
+            nnueAddFeature(acc, piece, bitScanForward(bb));
+}
+
+void nnueAttach(NnueStack *stack, const uint64_t pieces[12])
+{
+    stack->top = 0;
+    nnueRefresh(stack->acc[0], pieces);
+    nnueStack = stack;
+}
+
+void nnueDetach()
+{
+    nnueStack = NULL;
+}
+
+int nnueEnter(NnueAccumulators *acc)
+{
+    NnueStack *stack = nnueStack;
+    if (!stack) return 0;
+    int top = stack->top;
+    memcpy(stack->acc[top + 1], acc, sizeof(NnueAccumulators));
+    stack->top = top + 1;
+    return top;
+}
+
+void nnueLeave(int top)
+{
+    if (nnueStack) nnueStack->top = top;
+}
+
+static inline int clip(int x)
+{
+    return x < 0 ? 0 : x > NNUE_CLIP ? NNUE_CLIP : x;
+}
+
+int nnueEvaluate(int16_t acc[2][NNUE_HIDDEN], int color)
+{
+    int8_t input[2 * NNUE_HIDDEN];
+    int32_t hidden[NNUE_L1];
+    // The side to move comes first
+    for (int i = 0; i < NNUE_HIDDEN; ++i)
+    {
+        input[i] = clip(acc[color][i]);
+        input[NNUE_HIDDEN + i] = clip(acc[color ^ 1][i]);
+    }
+    denseKernel(input, hidden);
+    // The bias can be any 32 bit value, so add up past 32 bits
+    int64_t output = nnueNet.outBias;
+    for (int j = 0; j < NNUE_L1; ++j)
+        output += clip(hidden[j] / (1 << NNUE_WEIGHT_SHIFT))
+                * nnueNet.outWeights[j];
+    output /= 1 << NNUE_OUTPUT_SHIFT;
+    // Any network can score past the mate scores, the search can't tell
+    // those apart from real mates
+    if (output >= SCORE_MATE_BOUND) return SCORE_MATE_BOUND - 1;
+    if (output <= -SCORE_MATE_BOUND) return -(SCORE_MATE_BOUND - 1);
+    return output;
+}
@@ -2,17 +2,31 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>     // unlink()
 
 #include "board.h"
 #include "engine.h"
+#include "eval.h"
+#include "nnue.h"
 #include "bitHelpers.h"
+#include "magic.h"
 #include "timer.h"
+#include "tt.h"
+#include "timeman.h"
+#include "uci.h"
+#include "bench.h"
 
 static char *good = "\e[32m";
 static char *bad = "\e[31m";
 static char *clear = "\e[0m";
 static char *nameColor = "\e[33m";
 
+/* Number of calls timed by the bithelpers micro-benchmark */
+#define BITOP_BENCH_SIZE 10000000
+
+/* Rounds of the evaluation benchmark, each evaluates every benchmark position */
+#define EVAL_BENCH_SIZE 1000000
+
 void printInt(int x) { fprintf(stderr, "%d\n", x); }
 
 int intDiff(int a, int b) { return a - b; }
@@ -55,6 +69,63 @@ PerftInfo* runPerftTest(Board *board, PerftInfo *pi, uint8_t depth)
     return pi;
 }
 
+/*
+ * Runs a perft to depth on threads threads, split into tasks down to split
+ * plies, then puts the old settings back
+ */
+PerftInfo* runPerftSplit(Board *board, PerftInfo *pi, uint8_t depth,
+                         int split, int threads)
+{
+    int oldSplit = g_state.perftSplit;
+    int oldThreads = g_state.threads;
+    g_state.perftSplit = split;
+    g_state.threads = threads;
+    runPerftTest(board, pi, depth);
+    g_state.perftSplit = oldSplit;
+    g_state.threads = oldThreads;
+    return pi;
+}
+
+/*
+ * Returns the number of leaf nodes of a perft to depth, for reference counts
+ * that give no other totals
+ */
+int perftNodes(Board *board, uint8_t depth)
+{
+    PerftInfo pi;
+    runPerftTest(board, &pi, depth);
+    return pi.nodes;
+}
+
+/*
+ * Returns the sum of the per move counts of a divide to depth
+ */
+uint64_t divideTotal(Board *board, uint8_t depth)
+{
+    Move moves[MAX_MOVES_PER_POSITION];
+    uint64_t counts[MAX_MOVES_PER_POSITION];
+    uint64_t total = 0;
+    int n = perftDivide(board, depth, moves, counts);
+    for (int i = 0; i < n; ++i)
+        total += counts[i];
+    return total;
+}
+
+/*
+ * Returns the count a divide to depth gives for the move from src to dst, or
+ * -1 if it is not one of the root moves
+ */
+int64_t divideMove(Board *board, uint8_t depth, int src, int dst)
+{
+    Move moves[MAX_MOVES_PER_POSITION];
+    uint64_t counts[MAX_MOVES_PER_POSITION];
+    int n = perftDivide(board, depth, moves, counts);
+    for (int i = 0; i < n; ++i)
+        if (mgetsrc(moves[i]) == src && mgetdst(moves[i]) == dst)
+            return counts[i];
+    return -1;
+}
+
 PerftInfo* perftDiff(PerftInfo *check, PerftInfo *ref)
 {
     PerftInfo *diff = malloc(sizeof(PerftInfo));
@@ -81,6 +152,692 @@ Move moveDiff(Move check, Move ref)
 
 void noFree(void *a) { return; }
 
+/*
+ * BENCH_BITOP
+ * @brief defines a function that sums op over n pseudo random bitboards, used
+ * to time the bit helpers against each other. Bitboards are thinned out to look
+ * more like real positions
+ */
+#define BENCH_BITOP( name, op ) \
+uint64_t name(int n) \
+{ \
+    uint64_t sum = 0; \
+    uint64_t x = 0x9E3779B97F4A7C15UL; \
+    for (int i = 0; i < n; ++i) \
+    { \
+        x ^= x << 13; \
+        x ^= x >> 7; \
+        x ^= x << 17; \
+        sum += op((x & (x >> 3)) | 1); \
+    } \
+    return sum; \
+}
+
+/* Obviously correct versions to check the benchmarked helpers against */
+int refNumBits(uint64_t x)
+{
+    int n = 0;
+    for (int i = 0; i < 64; ++i) n += (x >> i) & 1;
+    return n;
+}
+int refScanForward(uint64_t x)
+{
+    int i = 0;
+    while (!((x >> i) & 1)) i++;
+    return i;
+}
+int refScanReverse(uint64_t x)
+{
+    int i = 63;
+    while (!((x >> i) & 1)) i--;
+    return i;
+}
+
+BENCH_BITOP(benchNumBitsRef, refNumBits)
+BENCH_BITOP(benchNumBitsPortable, getNumBitsPortable)
+BENCH_BITOP(benchNumBits, getNumBits)
+BENCH_BITOP(benchScanForwardRef, refScanForward)
+BENCH_BITOP(benchScanForwardPortable, bitScanForwardPortable)
+BENCH_BITOP(benchScanForward, bitScanForward)
+BENCH_BITOP(benchScanReverseRef, refScanReverse)
+BENCH_BITOP(benchScanReversePortable, bitScanReversePortable)
+BENCH_BITOP(benchScanReverse, bitScanReverse)
+
+/*
+ * Compares the slider lookups of this build, magic numbers or pext, with
+ * walking the rays on every square over a set of pseudo random occupancies.
+ * Returns the number of differences
+ */
+int sliderMismatches()
+{
+    int mismatches = 0;
+    uint64_t occupancy = 0x9E3779B97F4A7C15UL;
+    for (int i = 0; i < 1000; ++i)
+    {
+        occupancy ^= occupancy << 13;
+        occupancy ^= occupancy >> 7;
+        occupancy ^= occupancy << 17;
+        // Sparse boards look more like real positions
+        uint64_t occ = occupancy & (occupancy >> 3);
+        for (int square = 0; square < 64; ++square)
+        {
+            if (magicLookupBishop(occ, square)
+                != computeBishopAttacks(occ, square)) mismatches++;
+            if (magicLookupRook(occ, square)
+                != computeRookAttacks(occ, square)) mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/*
+ * Stores an entry for the hash and returns the data probed back, 0 on a miss
+ */
+uint64_t ttRoundTrip(uint64_t storeHash, uint64_t probeHash, Move move,
+                     int score, int depth, int bound)
+{
+    uint64_t data = 0;
+    ttStore(storeHash, move, score, depth, bound);
+    if (!ttProbe(probeHash, &data)) return 0;
+    return data;
+}
+
+/*
+ * Plays every legal move to the given depth and compares the incrementally
+ * updated hash and pawn hash against ones computed from scratch after every
+ * boardMove and undoMove. Returns the number of mismatches
+ */
+int hashMismatches(Board *board, int depth)
+{
+    if (depth == 0) return 0;
+    int mismatches = 0;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        if (board->hash != computeHash(board)) mismatches++;
+        if (board->pawnHash != computePawnHash(board)) mismatches++;
+        mismatches += hashMismatches(board, depth - 1);
+        undoMove(board, undo);
+        if (board->hash != computeHash(board)) mismatches++;
+        if (board->pawnHash != computePawnHash(board)) mismatches++;
+    }
+    return mismatches;
+}
+
+/*
+ * Passes the turn and compares the hash against one computed from scratch,
+ * then checks undoNullMove puts the board back. Returns the number of
+ * mismatches
+ */
+int nullMoveMismatches(Board board)
+{
+    Board before = board;
+    int mismatches = 0;
+    uint16_t info = boardNullMove(&board);
+    if (board.hash != computeHash(&board)) mismatches++;
+    if (bgetcol(board.info) == bgetcol(before.info)) mismatches++;
+    if (bgetenp(board.info)) mismatches++;
+    undoNullMove(&board, info);
+    if (board.hash != before.hash || board.info != before.info) mismatches++;
+    return mismatches;
+}
+
+/*
+ * Plays every legal move to the given depth and compares the cached
+ * occupancy and mailbox against ones rebuilt from the bitboards after every
+ * boardMove and undoMove. Returns the number of mismatches
+ */
+int occupancyMismatches(Board *board, int depth)
+{
+    if (depth == 0) return 0;
+    int mismatches = 0;
+    Board ref;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        ref = *board;
+        syncBoard(&ref);
+        if (memcmp(ref.occupancy, board->occupancy, sizeof(ref.occupancy)) ||
+            ref.occupied != board->occupied ||
+            memcmp(ref.mailbox, board->mailbox, sizeof(ref.mailbox)))
+            mismatches++;
+        mismatches += occupancyMismatches(board, depth - 1);
+        undoMove(board, undo);
+        ref = *board;
+        syncBoard(&ref);
+        if (memcmp(ref.occupancy, board->occupancy, sizeof(ref.occupancy)) ||
+            ref.occupied != board->occupied ||
+            memcmp(ref.mailbox, board->mailbox, sizeof(ref.mailbox)))
+            mismatches++;
+    }
+    return mismatches;
+}
+
+/*
+ * Returns 1 if the piece-square sums and phase of board differ from ones
+ * rebuilt from its bitboards
+ */
+static int psqtDiffers(Board *board)
+{
+    Board ref = *board;
+    syncBoard(&ref);
+    return ref.psqtMg != board->psqtMg || ref.psqtEg != board->psqtEg
+        || ref.phase != board->phase;
+}
+
+/*
+ * Plays every legal move to the given depth and compares the incrementally
+ * updated piece-square sums against rebuilt ones after every boardMove and
+ * undoMove. Returns the number of mismatches
+ */
+int psqtMismatches(Board *board, int depth)
+{
+    if (depth == 0) return 0;
+    int mismatches = 0;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        mismatches += psqtDiffers(board);
+        mismatches += psqtMismatches(board, depth - 1);
+        undoMove(board, undo);
+        mismatches += psqtDiffers(board);
+    }
+    return mismatches;
+}
+
+/*
+ * Plays every legal move to the given depth and compares the pawn structure
+ * scores from the pawn hash table against ones scored from scratch. Returns
+ * the number of positions where they differ
+ */
+int pawnTableMismatches(Board *board, int depth)
+{
+    PawnEntry fresh;
+    int mg = 0, eg = 0;
+    evaluatePawns(board, &mg, &eg);
+    scorePawns(board, &fresh);
+    int mismatches = mg != fresh.mg || eg != fresh.eg;
+    if (depth == 0) return mismatches;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        mismatches += pawnTableMismatches(board, depth - 1);
+        undoMove(board, undo);
+    }
+    return mismatches;
+}
+
+/*
+ * Returns the middlegame pawn structure score of the position in fen, or the
+ * endgame one if eg is set
+ */
+int pawnScore(char *fen, int eg)
+{
+    Board board;
+    PawnEntry entry;
+    loadFen(&board, fen);
+    scorePawns(&board, &entry);
+    return eg ? entry.eg : entry.mg;
+}
+
+/*
+ * Returns the middlegame mobility and king attack score of the position in
+ * fen, or the endgame one if eg is set
+ */
+int pieceScore(char *fen, int eg)
+{
+    Board board;
+    int scores[2] = {0, 0};
+    loadFen(&board, fen);
+    evaluatePieces(&board, &scores[0], &scores[1]);
+    return scores[eg != 0];
+}
+
+/* Positions evaluated by the evaluation benchmark */
+static char *benchFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+#define NUM_BENCH_FENS (sizeof(benchFens) / sizeof(benchFens[0]))
+
+/*
+ * Evaluates the benchmark positions n times each and returns the sum of the
+ * scores, so the time per evaluation can be read off the test
+ */
+int64_t benchEvaluate(int n)
+{
+    Board boards[NUM_BENCH_FENS];
+    for (unsigned i = 0; i < NUM_BENCH_FENS; ++i)
+        loadFen(&boards[i], benchFens[i]);
+    int64_t sum = 0;
+    for (int j = 0; j < n; ++j)
+        for (unsigned i = 0; i < NUM_BENCH_FENS; ++i)
+            sum += evaluateBoard(&boards[i]);
+    return sum;
+}
+
+/*
+ * Writes a network of pseudo random weights from seed to a new temporary
+ * file and puts its name in path, which needs room for 32 bytes. The weights
+ * cover the extremes of their types so the kernels see every corner case.
+ * Returns 0 on success
+ */
+int writeTestNetwork(char *path, uint64_t seed)
+{
+    static NnueNetwork net;
+    uint64_t state = seed;
+#define NEXT_RAND() (state ^= state << 13, state ^= state >> 7, \
+                     state ^= state << 17, state)
+    for (int i = 0; i < NNUE_HIDDEN; ++i)
+        net.featureBias[i] = (int)(NEXT_RAND() % 129) - 32;
+    for (int i = 0; i < NNUE_INPUTS; ++i)
+        for (int j = 0; j < NNUE_HIDDEN; ++j)
+            net.featureWeights[i][j] = (int)(NEXT_RAND() % 65) - 32;
+    for (int i = 0; i < NNUE_L1; ++i)
+    {
+        net.l1Bias[i] = (int)(NEXT_RAND() % 2049) - 1024;
+        // Mostly small so the sums stay inside the clipping range, with two
+        // at the limits of int8_t
+        for (int j = 0; j < 2 * NNUE_HIDDEN; ++j)
+            net.l1Weights[i][j] = (int)(NEXT_RAND() % 9) - 4;
+        net.l1Weights[i][i] = 127;
+        net.l1Weights[i][NNUE_HIDDEN + i] = -128;
+        net.outWeights[i] = (int8_t)NEXT_RAND();
+    }
+    net.outBias = (int)(NEXT_RAND() % 2049) - 1024;
+#undef NEXT_RAND
+    strcpy(path, "/tmp/lefoux-nnue-XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) return 1;
+    FILE *f = fdopen(fd, "wb");
+    if (!f) return 1;
+    uint32_t header[4] = {NNUE_MAGIC, NNUE_VERSION, NNUE_HIDDEN, NNUE_L1};
+    fwrite(header, sizeof(uint32_t), 4, f);
+    fwrite(net.featureBias, sizeof(int16_t), NNUE_HIDDEN, f);
+    fwrite(net.featureWeights, sizeof(int16_t), NNUE_INPUTS * NNUE_HIDDEN, f);
+    fwrite(net.l1Bias, sizeof(int32_t), NNUE_L1, f);
+    fwrite(net.l1Weights, sizeof(int8_t), NNUE_L1 * 2 * NNUE_HIDDEN, f);
+    fwrite(&net.outBias, sizeof(int32_t), 1, f);
+    fwrite(net.outWeights, sizeof(int8_t), NNUE_L1, f);
+    return fclose(f) != 0;
+}
+
+/*
+ * Plays every legal move to the given depth and compares the top of the
+ * accumulator stack against rebuilt accumulators after every boardMove and
+ * undoMove. Returns the number of mismatches
+ */
+int stackMismatches(Board *board, int depth)
+{
+    if (depth == 0) return 0;
+    int mismatches = 0;
+    NnueAccumulators ref;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        nnueRefresh(ref, board->pieces);
+        mismatches += memcmp(ref, nnueCurrent(), sizeof(ref)) != 0;
+        mismatches += stackMismatches(board, depth - 1);
+        undoMove(board, undo);
+        nnueRefresh(ref, board->pieces);
+        mismatches += memcmp(ref, nnueCurrent(), sizeof(ref)) != 0;
+    }
+    return mismatches;
+}
+
+/*
+ * Runs stackMismatches on a stack attached for board, and counts one more
+ * mismatch if the moves didn't leave the stack where it started
+ */
+int accumulatorMismatches(Board *board, int depth)
+{
+    static NnueStack stack;
+    nnueAttach(&stack, board->pieces);
+    int mismatches = stackMismatches(board, depth);
+    mismatches += stack.top != 0;
+    nnueDetach();
+    return mismatches;
+}
+
+/*
+ * Plays every legal move to the given depth and evaluates every position with
+ * the scalar kernel and with kernel. Returns the number of positions where
+ * they differ, or -1 if the cpu doesn't support kernel
+ */
+int kernelMismatches(Board *board, int depth, int kernel)
+{
+    if (!nnueSetKernel(kernel)) return -1;
+    NnueAccumulators acc;
+    nnueRefresh(acc, board->pieces);
+    int score = nnueEvaluate(acc, bgetcol(board->info));
+    nnueSetKernel(NNUE_SCALAR);
+    int mismatches = score != nnueEvaluate(acc, bgetcol(board->info));
+    if (depth == 0) return mismatches;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        mismatches += kernelMismatches(board, depth - 1, kernel);
+        undoMove(board, undo);
+    }
+    return mismatches;
+}
+
+/*
+ * Plays every legal move to the given depth and compares genLegalCaptures
+ * against the captures among genAllLegalMoves at every node. Returns the
+ * number of nodes where they differ
+ */
+int captureMismatches(Board *board, int depth)
+{
+    if (depth == 0) return 0;
+    int mismatches = 0;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    Move captures[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    int n_captures = genLegalCaptures(board, captures);
+    int i, j = 0;
+    // Both generators emit moves in the same order
+    for (i = 0; i < n_moves; ++i)
+        if (mgettaken(movelist[i]) != 0x7)
+            if (j >= n_captures || captures[j++] != movelist[i])
+                mismatches++;
+    if (j != n_captures) mismatches++;
+    for (i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        mismatches += captureMismatches(board, depth - 1);
+        undoMove(board, undo);
+    }
+    return mismatches;
+}
+
+/* History scores used by pickerMismatches to order quiet moves */
+static int pickerHistory[64][64];
+
+/*
+ * Plays every legal move to the given depth and checks that a MovePicker hands
+ * out exactly the moves of genAllLegalMoves at every node. The table move,
+ * first killer and counter move are taken from the legal moves so every stage
+ * is used, the second killer is never legal. Returns the number of nodes
+ * where they differ
+ */
+
+int pickerMismatches(Board *board, int depth)
+{
+    if (depth == 0) return 0;
+    int mismatches = 0;
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    MovePicker mp;
+    initMovePicker(&mp, n_moves ? movelist[n_moves - 1] : 0,
+                   n_moves ? movelist[n_moves / 2] : 0,
+                   mcreate(0, IA1, IH8, KNIGHT, 0, bgetcol(board->info)),
+                   n_moves ? movelist[n_moves / 3] : 0, pickerHistory);
+    int seen = 0;
+    Move m;
+    while ((m = nextMove(&mp, board)))
+    {
+        int found = 0;
+        for (int i = 0; i < n_moves; ++i)
+            if (movelist[i] == m) found = 1;
+        if (!found) mismatches++;
+        seen++;
+    }
+    if (seen != n_moves) mismatches++;
+    for (int i = 0; i < n_moves; ++i)
+    {
+        Move undo = boardMove(board, movelist[i]);
+        mismatches += pickerMismatches(board, depth - 1);
+        undoMove(board, undo);
+    }
+    return mismatches;
+}
+
+/*
+ * Checks legalMove against genAllLegalMoves at every node to depth. The moves
+ * tried are the legal ones, the ones of the parent node and copies of both
+ * with another piece, promotion or color. Returns the number of moves where
+ * legalMove doesn't give the generated move, or 0 for one that isn't
+ * generated
+ */
+int legalMoveMismatches(Board *board, int depth, const Move *parent,
+                        int numParent)
+{
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(board, movelist);
+    int mismatches = 0;
+    for (int i = 0; i < n_moves + numParent; ++i)
+    {
+        Move base = mgetmove(i < n_moves ? movelist[i] : parent[i - n_moves]);
+        Move tries[4] = {
+            base,
+            (base & ~(0x7 << 4)) | (((mgetpiece(base) + 1) % 6) << 4),
+            (base & ~(0x7 << 1)) | (((mgetprom(base) + 1) % 5) << 1),
+            base ^ 1
+        };
+        for (int t = 0; t < 4; ++t)
+        {
+            Move expected = 0;
+            for (int j = 0; j < n_moves; ++j)
+                if (mgetmove(movelist[j]) == tries[t]) expected = movelist[j];
+            if (legalMove(board, tries[t]) != expected) mismatches++;
+        }
+    }
+    if (depth > 1)
+    {
+        for (int i = 0; i < n_moves; ++i)
+        {
+            Move undo = boardMove(board, movelist[i]);
+            mismatches += legalMoveMismatches(board, depth - 1, movelist,
+                                              n_moves);
+            undoMove(board, undo);
+        }
+    }
+    return mismatches;
+}
+
+/*
+ * Runs a move picker with the move given in Long Algebraic Notation as the
+ * table move. Returns the number of moves it hands out that are not legal or
+ * not in the right place: the table move has to come first, and every legal
+ * move once
+ */
+int pickerTableMoveMismatches(Board board, char *lan)
+{
+    Move movelist[MAX_MOVES_PER_POSITION];
+    int n_moves = genAllLegalMoves(&board, movelist);
+    Move ttMove = parseLANMove(&board, lan);
+    MovePicker mp;
+    initMovePicker(&mp, ttMove, 0, 0, 0, NULL);
+    int mismatches = 0;
+    int seen = 0;
+    Move m;
+    while ((m = nextMove(&mp, &board)))
+    {
+        int found = 0;
+        for (int i = 0; i < n_moves; ++i)
+            if (movelist[i] == m) found = 1;
+        if (!found || (!seen && mgetmove(m) != mgetmove(ttMove)))
+            mismatches++;
+        seen++;
+    }
+    return mismatches + (seen != n_moves);
+}
+
+/*
+ * Returns the static exchange value of the legal move given in Long
+ * Algebraic Notation
+ */
+int seeOfMove(Board board, char *lan)
+{
+    Move moves[MAX_MOVES_PER_POSITION];
+    Move m = parseLANMove(&board, lan);
+    int n = genAllLegalMoves(&board, moves);
+    for (int i = 0; i < n; ++i)
+        if ((moves[i] & 0x7ffff) == (m & 0x7ffff))
+            return staticExchange(&board, moves[i]);
+    return -1000;
+}
+
+/*
+ * Runs findBestMove on a copy of board with the given search mode and thread
+ * count, then puts the old settings back
+ */
+Move findBestMoveWith(Board board, uint8_t depth, int mode, int threads)
+{
+    int oldMode = g_state.searchMode;
+    int oldThreads = g_state.threads;
+    g_state.searchMode = mode;
+    g_state.threads = threads;
+    ttClear();
+    Move m = findBestMove(&board, depth);
+    g_state.searchMode = oldMode;
+    g_state.threads = oldThreads;
+    return m;
+}
+
+/*
+ * Runs findBestMove on a copy of board on one thread with only the pruning
+ * techniques in pruning, then puts the old settings back
+ */
+Move findBestMovePruning(Board board, uint8_t depth, int pruning)
+{
+    int oldPruning = g_state.pruning;
+    int oldThreads = g_state.threads;
+    g_state.pruning = pruning;
+    g_state.threads = 1;
+    ttClear();
+    Move m = findBestMove(&board, depth);
+    g_state.pruning = oldPruning;
+    g_state.threads = oldThreads;
+    return m;
+}
+
+/*
+ * Searches board to the deepest depth with the given movetime. Returns 1 if
+ * the search stopped within a tenth of movetime of its deadline
+ */
+int searchStopsInTime(Board board, int movetime)
+{
+    timeStart(-1, 0, 0, movetime);
+    findBestMove(&board, MAX_SEARCH_DEPTH);
+    uint64_t elapsed = timeElapsed();
+    // Clear the deadline so later searches aren't limited by it
+    timeStart(-1, 0, 0, 0);
+    return elapsed <= (uint64_t)movetime + movetime / 10;
+}
+
+/*
+ * Searches board to the deepest depth on one thread with the given node
+ * limit. Returns 1 if the search stopped within a batch of the limit
+ */
+int searchStopsAtNodes(Board board, uint64_t nodes)
+{
+    int oldThreads = g_state.threads;
+    g_state.threads = 1;
+    setNodeLimit(nodes);
+    findBestMove(&board, MAX_SEARCH_DEPTH);
+    setNodeLimit(0);
+    g_state.threads = oldThreads;
+    return searchedNodes() >= nodes && searchedNodes() <= nodes + NODE_BATCH;
+}
+
+/*
+ * Searches board to depth and plays the move found. Returns 1 if the move
+ * checkmates
+ */
+int searchFindsMate(Board board, uint8_t depth)
+{
+    boardMove(&board, findBestMove(&board, depth));
+    Move moves[MAX_MOVES_PER_POSITION];
+    return !genAllLegalMoves(&board, moves) && inCheck(&board);
+}
+
+/*
+ * Searches board to depth twice on one thread, from an empty transposition
+ * table each time. Returns 1 if both searches play the same move
+ */
+int searchRepeats(Board board, uint8_t depth)
+{
+    int oldThreads = g_state.threads;
+    g_state.threads = 1;
+    ttClear();
+    Move first = findBestMove(&board, depth);
+    ttClear();
+    Move second = findBestMove(&board, depth);
+    g_state.threads = oldThreads;
+    return first == second;
+}
+
+/*
+ * Runs suite as a bench on the given threads and returns what runBench
+ * returns. signature is set to the signature it printed
+ */
+int benchSuite(const char *suite, int threads, uint64_t *signature)
+{
+    int oldThreads = g_state.threads;
+    g_state.threads = threads;
+    FILE *epd = fmemopen((void *)suite, strlen(suite), "r");
+    int result = runBench(epd, signature);
+    fclose(epd);
+    g_state.threads = oldThreads;
+    return result;
+}
+
+/*
+ * Runs suite on one thread twice, returns 1 if both give the same signature
+ */
+int benchSignatureRepeats(const char *suite)
+{
+    uint64_t first, second;
+    benchSuite(suite, 1, &first);
+    benchSuite(suite, 1, &second);
+    return first && first == second;
+}
+
+/*
+ * Searches board to depth with the root limited to the move given in Long
+ * Algebraic Notation, then lifts the limit. Returns the move found
+ */
+Move searchOnlyMove(Board board, uint8_t depth, char *lan)
+{
+    Move m = parseLANMove(&board, lan);
+    setSearchMoves(&m, 1);
+    Move found = findBestMove(&board, depth);
+    setSearchMoves(NULL, 0);
+    return found & 0x7ffff;
+}
+
+/*
+ * Plays a sequence of moves in Long Algebraic Notation separated by spaces
+ * and returns the resulting hash
+ */
+uint64_t hashAfterMoves(Board board, char *moves)
+{
+    char movestr[8];
+    int n;
+    while (sscanf(moves, "%7s%n", movestr, &n) == 1)
+    {
+        boardMove(&board, parseLANMove(&board, movestr));
+        moves += n;
+    }
+    return board.hash;
+}
+
 /*
  * tests
  * @brief runs a series of tests
@@ -164,6 +921,26 @@ int tests()
               uint64_t, 0xFF00000000000000UL, printLongHex, xor64bit, noFree);
     RUN_TEST( "getNumBits", getNumBits( 0xFFUL ), int, 8, printInt, intDiff, noFree);
 
+    /* Bithelpers micro-benchmark, compare the times of the two variants */
+    fprintf(stderr, " -- Bithelpers Benchmark (POPCNT = %d) -- \n", HW_POPCOUNT);
+    uint64_t bitsRef = benchNumBitsRef(BITOP_BENCH_SIZE);
+    RUN_TEST( "getNumBitsPortable x10M", benchNumBitsPortable(BITOP_BENCH_SIZE),
+              uint64_t, bitsRef, printLongHex, xor64bit, noFree);
+    RUN_TEST( "getNumBits x10M", benchNumBits(BITOP_BENCH_SIZE),
+              uint64_t, bitsRef, printLongHex, xor64bit, noFree);
+    bitsRef = benchScanForwardRef(BITOP_BENCH_SIZE);
+    RUN_TEST( "bitScanForwardPortable x10M",
+              benchScanForwardPortable(BITOP_BENCH_SIZE),
+              uint64_t, bitsRef, printLongHex, xor64bit, noFree);
+    RUN_TEST( "bitScanForward x10M", benchScanForward(BITOP_BENCH_SIZE),
+              uint64_t, bitsRef, printLongHex, xor64bit, noFree);
+    bitsRef = benchScanReverseRef(BITOP_BENCH_SIZE);
+    RUN_TEST( "bitScanReversePortable x10M",
+              benchScanReversePortable(BITOP_BENCH_SIZE),
+              uint64_t, bitsRef, printLongHex, xor64bit, noFree);
+    RUN_TEST( "bitScanReverse x10M", benchScanReverse(BITOP_BENCH_SIZE),
+              uint64_t, bitsRef, printLongHex, xor64bit, noFree);
+
     /* Magic Lookup Tests */
     fprintf(stderr, " -- Magic Lookup -- \n");
     RUN_TEST( "magicLookupRook few occupancies",
@@ -184,6 +961,9 @@ int tests()
              magicLookupBishop( 0xFFFFUL << 48, IB2 ), uint64_t,
              0x0040201008050005, printBitboard, xor64bit , noFree);
 
+    RUN_TEST( "slider lookups match walking the rays", sliderMismatches(), int, 0,
+              printInt, intDiff, noFree);
+
     /* boardMove Tests */
     b = getDefaultBoard();
     fprintf(stderr, " -- Board Moves -- \n");
@@ -197,6 +977,7 @@ int tests()
     b.pieces[KNIGHT] = 0UL;
     b.pieces[BISHOP] = 0UL;
     m = mcreate(0, IA1, IB1, ROOK, 0, _WHITE);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("queenside white rook affect castling", b.info, uint16_t,
              (0x7 << 1) | _BLACK, printBoardInfo, xorInt, noFree);
@@ -204,6 +985,7 @@ int tests()
     b.pieces[KNIGHT] = 0UL;
     b.pieces[BISHOP] = 0UL;
     m = mcreate(0, IH1, IG1, ROOK, 0, _WHITE);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("kingside white rook affect castling", b.info, uint16_t,
              (0xb << 1) | _BLACK, printBoardInfo, xorInt, noFree);
@@ -211,6 +993,7 @@ int tests()
     b.pieces[KNIGHT] = 0UL;
     b.pieces[BISHOP] = 0UL;
     m = mcreate(0, IE1, IF1, KING, 0, _WHITE);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("white king affect castling", b.info, uint16_t,
              (0x3 << 1) | _BLACK, printBoardInfo, xorInt , noFree);
@@ -224,6 +1007,7 @@ int tests()
     RUN_TEST("mgetcol macro check",
              (mgetcol(_BLACK | (PAWN << 4) | (IE7 << 13) | (IE5 << 7))),
               int, _BLACK, printInt, intDiff, noFree);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("pawn e7e5 boardMove", b.pieces[_PAWN], uint64_t,
              (RANK[6] ^ E7) | E5, printBitboard, xor64bit, noFree);
@@ -234,6 +1018,7 @@ int tests()
     b.pieces[_KNIGHT] = 0UL;
     b.pieces[_BISHOP] = 0UL;
     m = mcreate(0, IA8, IB8, ROOK, 0, _BLACK);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("queenside black rook affect castling", b.info, uint16_t,
             (0xd << 1) | _WHITE, printBoardInfo, xorInt, noFree);
@@ -242,6 +1027,7 @@ int tests()
     b.pieces[_KNIGHT] = 0UL;
     b.pieces[_BISHOP] = 0UL;
     m = mcreate(0, IH8, IG8, ROOK, 0, _BLACK);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("kingside black rook affect castling", b.info, uint16_t,
             (0xe << 1) | _WHITE, printBoardInfo, xorInt, noFree);
@@ -250,6 +1036,7 @@ int tests()
     b.pieces[_KNIGHT] = 0UL;
     b.pieces[_BISHOP] = 0UL;
     m = mcreate(0, IE8, IF8, KING, 0, _BLACK);
+    syncBoard(&b);
     boardMove(&b, m);
     RUN_TEST("black king affect castling", b.info, uint16_t,
             (0xc << 1) | _WHITE, printBoardInfo, xorInt, noFree);
@@ -259,6 +1046,7 @@ int tests()
     b.pieces[KNIGHT] = 0UL;
     b.pieces[BISHOP] = 0UL;
     m = mcreate(0, IE1, IG1, KING, 0, _WHITE);
+    syncBoard(&b);
     boardMove(&b, m);
     target = getDefaultBoard();
     target.info |= _BLACK;
@@ -276,6 +1064,7 @@ int tests()
     b.pieces[BISHOP] = 0UL;
     b.pieces[QUEEN] = 0UL;
     m = mcreate(0, IE1, IC1, KING, 0, _WHITE);
+    syncBoard(&b);
     boardMove(&b, m);
     target = getDefaultBoard();
     target.info |= _BLACK;
@@ -293,6 +1082,7 @@ int tests()
     b.pieces[_KNIGHT] = 0UL;
     b.pieces[_BISHOP] = 0UL;
     m = mcreate(0, IE8, IG8, KING, 0, _BLACK);
+    syncBoard(&b);
     boardMove(&b, m);
     target = getDefaultBoard();
     target.info |= _WHITE;
@@ -310,6 +1100,7 @@ int tests()
     b.pieces[_BISHOP] = 0UL;
     b.pieces[_QUEEN] = 0UL;
     m = mcreate(0, IE8, IC8, KING, 0, _BLACK);
+    syncBoard(&b);
     boardMove(&b, m);
     target = getDefaultBoard();
     target.info |= _WHITE;
@@ -344,6 +1135,48 @@ int tests()
     RUN_TEST( "genAllLegalMoves from 1. h4 e5 2. h5 g5",
               (genAllLegalMoves(&b, allMoves)), int, 23, printInt, intDiff , noFree);
 
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ");
+    RUN_TEST("genLegalCaptures depth 3 - position 2",
+             captureMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+    RUN_TEST("genLegalCaptures depth 4 - position 3",
+             captureMismatches(&b, 4), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("genLegalCaptures depth 3 - position 4",
+             captureMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+
+    for (int i = 0; i < 64 * 64; ++i)
+        pickerHistory[i / 64][i % 64] = (i * 31) % 97;
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ");
+    RUN_TEST("MovePicker depth 3 - position 2",
+             pickerMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+    RUN_TEST("MovePicker depth 4 - position 3",
+             pickerMismatches(&b, 4), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("MovePicker depth 3 - position 4",
+             pickerMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ");
+    RUN_TEST("legalMove depth 3 - position 2",
+             legalMoveMismatches(&b, 3, NULL, 0), int, 0, printInt, intDiff,
+             noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+    RUN_TEST("legalMove depth 4 - position 3",
+             legalMoveMismatches(&b, 4, NULL, 0), int, 0, printInt, intDiff,
+             noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("legalMove depth 3 - position 4",
+             legalMoveMismatches(&b, 3, NULL, 0), int, 0, printInt, intDiff,
+             noFree);
+    loadFen(&b, "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+    RUN_TEST("legalMove depth 3 - en passant",
+             legalMoveMismatches(&b, 3, NULL, 0), int, 0, printInt, intDiff,
+             noFree);
+    loadFen(&b, "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3");
+    RUN_TEST("MovePicker en passant table move",
+             pickerTableMoveMismatches(b, "e5f6"), int, 0, printInt, intDiff,
+             noFree);
+
     /* FEN tests */
     fprintf(stderr, " -- FEN Tests -- \n");
     b = getDefaultBoard();
@@ -368,6 +1201,86 @@ int tests()
     undoMove(&b, undoM);
     RUN_TEST("Undo with en passant", &b, Board*, &fen_board,
               printBoard, boardDiff, free);
+    loadFen(&fen_board, "r3k3/1P6/8/8/8/8/6p1/4K2R w K - 0 1");
+    loadFen(&b, "r3k3/1P6/8/8/8/8/6p1/4K2R w K - 0 1");
+    undoM = boardMove(&b, mcreate(0, IB7, IA8, PAWN, KNIGHT, _WHITE));
+    m = boardMove(&b, mcreate(0, IG2, IH1, PAWN, QUEEN, _BLACK));
+    undoMove(&b, m);
+    undoMove(&b, undoM);
+    RUN_TEST("Undo with capturing promotions", &b, Board*, &fen_board,
+              printBoard, boardDiff, free);
+    loadFen(&fen_board, "N3k3/8/8/8/8/8/6p1/4K2R b K - 0 1");
+    boardMove(&b, mcreate(0, IB7, IA8, PAWN, KNIGHT, _WHITE));
+    RUN_TEST("Promote to a knight on a rook", &b, Board*, &fen_board,
+              printBoard, boardDiff, free);
+    m = parseLANMove(&b, "g2h1q");
+    char lan[7];
+    sprintLANMove(lan, m);
+    RUN_TEST("LAN promotion round trip", strcmp(lan, "g2h1q "), int, 0,
+              printInt, intDiff, noFree);
+
+    /* Zobrist tests */
+    fprintf(stderr, " -- Zobrist Tests -- \n");
+    b = getDefaultBoard();
+    RUN_TEST("Hash of default board", b.hash, uint64_t, computeHash(&b),
+             printLongHex, xor64bit, noFree);
+    RUN_TEST("Hash transposition 1. Nf3 Nf6 2. Nc3 / 1. Nc3 Nf6 2. Nf3",
+             hashAfterMoves(b, "g1f3 g8f6 b1c3"), uint64_t,
+             hashAfterMoves(b, "b1c3 g8f6 g1f3"), printLongHex, xor64bit,
+             noFree);
+    RUN_TEST("Hash differs by en passant 1. e4 / 1. e4 Nf6 2. Nf3 Ng8 3. Ng1",
+             (hashAfterMoves(b, "e2e4") ==
+              hashAfterMoves(b, "e2e4 g8f6 g1f3 f6g8 f3g1")), int, 0, printInt,
+             intDiff, noFree);
+    RUN_TEST("Incremental hash depth 3 from default board",
+             hashMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ");
+    RUN_TEST("Incremental hash depth 3 - position 2",
+             hashMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("Incremental hash depth 3 - position 4",
+             hashMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR w KQkq d6");
+    RUN_TEST("Null move hash with en passant",
+             nullMoveMismatches(b), int, 0, printInt, intDiff, noFree);
+
+    /* Occupancy tests */
+    fprintf(stderr, " -- Occupancy Tests -- \n");
+    b = getDefaultBoard();
+    RUN_TEST("Cached occupancy depth 3 from default board",
+             occupancyMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ");
+    RUN_TEST("Cached occupancy depth 3 - position 2",
+             occupancyMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    RUN_TEST("Piece-square sums depth 3 - position 2",
+             psqtMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+    RUN_TEST("Piece-square sums depth 4 - position 3",
+             psqtMismatches(&b, 4), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("Cached occupancy depth 3 - position 4",
+             occupancyMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    RUN_TEST("Piece-square sums depth 3 - position 4",
+             psqtMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+
+    /* Transposition table tests */
+    fprintf(stderr, " -- Transposition Table Tests -- \n");
+    b = getDefaultBoard();
+    m = mcreate(0, IE2, IE4, PAWN, 0, _WHITE);
+    RUN_TEST("TT store then probe move",
+             ttgetmove(ttRoundTrip(b.hash, b.hash, m, -42, 5, TT_LOWER)),
+             Move, m, printMoveSAN, moveDiff, noFree);
+    RUN_TEST("TT store then probe negative score",
+             ttgetscore(ttRoundTrip(b.hash, b.hash, m, -42, 5, TT_LOWER)),
+             int, -42, printInt, intDiff, noFree);
+    RUN_TEST("TT store then probe depth and bound",
+             ttgetdepth(ttRoundTrip(b.hash, b.hash, m, 7, 9, TT_UPPER)) * 4 +
+             ttgetbound(ttRoundTrip(b.hash, b.hash, m, 7, 9, TT_UPPER)),
+             int, 9 * 4 + TT_UPPER, printInt, intDiff, noFree);
+    RUN_TEST("TT probe other position misses",
+             ttRoundTrip(b.hash, b.hash ^ zobristColor, m, 7, 9, TT_UPPER),
+             uint64_t, 0, printLongHex, xor64bit, noFree);
+    ttClear();
 
     /* Evaluate Board tests */
     fprintf(stderr, " -- Evaluate Board Tests -- \n");
@@ -375,11 +1288,115 @@ int tests()
     RUN_TEST("evaluate default board", (evaluateBoard(&b)), int, 0, printInt,
              intDiff, noFree);
     loadFen(&b, "rnbqkbnr/p1pppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-    RUN_TEST("evaluate board 1 black pawn missing", (evaluateBoard(&b)), int, 1,
+    RUN_TEST("evaluate board 1 black pawn missing", (evaluateBoard(&b)), int, 81,
              printInt, intDiff, noFree);
     loadFen(&b, "rnbqkbnr/pppppppp/8/8/8/8/P1PPPPPP/RNBQKBNR w KQkq - 0 1");
     RUN_TEST("evaluate board 1 white pawn missing", (evaluateBoard(&b)), int,
-             -1, printInt, intDiff, noFree);
+             -81, printInt, intDiff, noFree);
+
+    RUN_TEST("pawns passed and isolated", pawnScore("4k3/8/8/8/8/8/4P3/4K3 w - -",
+             0), int, -5, printInt, intDiff, noFree);
+    RUN_TEST("pawns doubled", pawnScore("4k3/8/8/8/8/4P3/4P3/4K3 w - -", 1),
+             int, -35, printInt, intDiff, noFree);
+    RUN_TEST("pawns backward, passed and isolated middlegame",
+             pawnScore("4k3/8/8/2p5/4P3/3P4/8/4K3 w - -", 0), int, 17,
+             printInt, intDiff, noFree);
+    RUN_TEST("pawns backward, passed and isolated endgame",
+             pawnScore("4k3/8/8/2p5/4P3/3P4/8/4K3 w - -", 1), int, 40,
+             printInt, intDiff, noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+    RUN_TEST("pawn hash table depth 4 - position 3",
+             pawnTableMismatches(&b, 4), int, 0, printInt, intDiff, noFree);
+
+    RUN_TEST("mobility of a lone rook middlegame",
+             pieceScore("4k3/8/8/8/8/8/8/R3K3 w - -", 0), int, 6, printInt,
+             intDiff, noFree);
+    RUN_TEST("mobility of a lone rook endgame",
+             pieceScore("4k3/8/8/8/8/8/8/R3K3 w - -", 1), int, 12, printInt,
+             intDiff, noFree);
+    RUN_TEST("mobility and king attacks even on default board",
+             pieceScore("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+                        0), int, 0, printInt, intDiff, noFree);
+    // Mobility is worth 8, two attackers hitting the king zone with 16
+    // weight add half of it
+    RUN_TEST("king attack by queen and rook",
+             pieceScore("4k3/8/8/8/8/8/3QR3/4K3 w - -", 0), int,
+             8 + 16 * 50 / 20, printInt, intDiff, noFree);
+    int64_t evalRef = benchEvaluate(1) * EVAL_BENCH_SIZE;
+    RUN_TEST("evaluateBoard x4M", benchEvaluate(EVAL_BENCH_SIZE), int64_t,
+             evalRef, printLongHex, xor64bit, noFree);
+
+    /* NNUE tests, with a generated network */
+    fprintf(stderr, " -- NNUE Tests -- \n");
+    char netPath[32];
+    RUN_TEST("write test network", writeTestNetwork(netPath, 0x1234567UL),
+             int, 0, printInt, intDiff, noFree);
+    RUN_TEST("load test network", nnueLoad(netPath), int, 0, printInt,
+             intDiff, noFree);
+    RUN_TEST("load missing network fails", nnueLoad("/nonexistent.nnue"), int,
+             1, printInt, intDiff, noFree);
+    RUN_TEST("failed load keeps the network", nnueActive, int, 1, printInt,
+             intDiff, noFree);
+    unlink(netPath);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    RUN_TEST("accumulators depth 3 - position 2",
+             accumulatorMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -");
+    RUN_TEST("accumulators depth 4 - position 3",
+             accumulatorMismatches(&b, 4), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("accumulators depth 3 - position 4",
+             accumulatorMismatches(&b, 3), int, 0, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    if (__builtin_cpu_supports("sse4.1"))
+        RUN_TEST("SSE4.1 kernel matches scalar depth 2 - position 2",
+                 kernelMismatches(&b, 2, NNUE_SSE41), int, 0, printInt,
+                 intDiff, noFree);
+    if (__builtin_cpu_supports("avx2"))
+        RUN_TEST("AVX2 kernel matches scalar depth 2 - position 2",
+                 kernelMismatches(&b, 2, NNUE_AVX2), int, 0, printInt,
+                 intDiff, noFree);
+    nnueSetKernel(nnueBestKernel());
+    NnueAccumulators acc;
+    nnueRefresh(acc, b.pieces);
+    RUN_TEST("evaluateBoard uses the network", evaluateBoard(&b), int,
+             nnueEvaluate(acc, _WHITE), printInt, intDiff, noFree);
+    static NnueStack stack;
+    nnueAttach(&stack, b.pieces);
+    Move moves[MAX_MOVES_PER_POSITION];
+    genAllLegalMoves(&b, moves);
+    Move undo = boardMove(&b, moves[0]);
+    nnueRefresh(acc, b.pieces);
+    RUN_TEST("evaluateBoard uses the thread's stack", evaluateBoard(&b), int,
+             nnueEvaluate(acc, _BLACK), printInt, intDiff, noFree);
+    undoMove(&b, undo);
+    nnueDetach();
+    int32_t outBias = nnueNet.outBias;
+    nnueNet.outBias = 0x7fffffff;
+    RUN_TEST("network score stays below mate scores",
+             nnueEvaluate(acc, _WHITE), int, SCORE_MATE_BOUND - 1,
+             printInt, intDiff, noFree);
+    nnueNet.outBias = -0x7fffffff;
+    RUN_TEST("network score stays above mated scores",
+             nnueEvaluate(acc, _WHITE), int, -(SCORE_MATE_BOUND - 1),
+             printInt, intDiff, noFree);
+    nnueNet.outBias = outBias;
+    nnueDisable();
+
+    /* Static exchange tests */
+    fprintf(stderr, " -- Static Exchange Tests -- \n");
+    loadFen(&b, "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - -");
+    RUN_TEST("SEE rook takes undefended pawn", seeOfMove(b, "e1e5"), int, 100,
+             printInt, intDiff, noFree);
+    loadFen(&b, "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - -");
+    RUN_TEST("SEE knight takes pawn defended with x-rays", seeOfMove(b, "d3e5"),
+             int, -200, printInt, intDiff, noFree);
+    loadFen(&b, "4k3/8/8/3pP3/8/8/8/4K3 w - d6");
+    RUN_TEST("SEE en passant", seeOfMove(b, "e5d6"), int, 100, printInt, intDiff,
+             noFree);
+    loadFen(&b, "4k3/8/2p5/3p4/8/8/3Q4/4K3 w - -");
+    RUN_TEST("SEE queen takes defended pawn", seeOfMove(b, "d2d5"), int, -800,
+             printInt, intDiff, noFree);
 
     /* Perft tests */
     fprintf(stderr, " -- Default board perft tests -- \n");
@@ -421,6 +1438,124 @@ int tests()
     RUN_TEST("Perft depth 3 - position 2", runPerftTest(&b, &pi, 3), PerftInfo*,
               &((PerftInfo){97862, 17102, 45, 3162, 0, 993 ,0}),
               myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 4 - position 2", runPerftTest(&b, &pi, 4), PerftInfo*,
+              &((PerftInfo){4085603, 757163, 1929, 128013, 15172, 25523 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 3 - position 2, no split",
+              runPerftSplit(&b, &pi, 3, 0, 4), PerftInfo*,
+              &((PerftInfo){97862, 17102, 45, 3162, 0, 993 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 3 - position 2, split 1 ply on 4 threads",
+              runPerftSplit(&b, &pi, 3, 1, 4), PerftInfo*,
+              &((PerftInfo){97862, 17102, 45, 3162, 0, 993 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 3 - position 2, split 3 plies on 4 threads",
+              runPerftSplit(&b, &pi, 3, 3, 4), PerftInfo*,
+              &((PerftInfo){97862, 17102, 45, 3162, 0, 993 ,0}),
+              myPrintPerft, perftDiff, free);
+
+    /* Position 3 Perft Tests, en passant across pins and discovered checks */
+    fprintf(stderr, " -- Position 3 Perft Tests -- \n");
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    RUN_TEST("Perft depth 1 - position 3", runPerftTest(&b, &pi, 1), PerftInfo*,
+              &((PerftInfo){14, 1, 0, 0, 0, 2 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 2 - position 3", runPerftTest(&b, &pi, 2), PerftInfo*,
+              &((PerftInfo){191, 14, 0, 0, 0, 10 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 3 - position 3", runPerftTest(&b, &pi, 3), PerftInfo*,
+              &((PerftInfo){2812, 209, 2, 0, 0, 267 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 4 - position 3", runPerftTest(&b, &pi, 4), PerftInfo*,
+              &((PerftInfo){43238, 3348, 123, 0, 0, 1680 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 5 - position 3", runPerftTest(&b, &pi, 5), PerftInfo*,
+              &((PerftInfo){674624, 52051, 1165, 0, 0, 52950 ,0}),
+              myPrintPerft, perftDiff, free);
+
+    /* Position 4 Perft Tests, promotions and castling under fire */
+    fprintf(stderr, " -- Position 4 Perft Tests -- \n");
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("Perft depth 1 - position 4", runPerftTest(&b, &pi, 1), PerftInfo*,
+              &((PerftInfo){6, 0, 0, 0, 0, 0 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 2 - position 4", runPerftTest(&b, &pi, 2), PerftInfo*,
+              &((PerftInfo){264, 87, 0, 6, 48, 10 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 3 - position 4", runPerftTest(&b, &pi, 3), PerftInfo*,
+              &((PerftInfo){9467, 1021, 4, 0, 120, 38 ,0}),
+              myPrintPerft, perftDiff, free);
+    RUN_TEST("Perft depth 4 - position 4", runPerftTest(&b, &pi, 4), PerftInfo*,
+              &((PerftInfo){422333, 131393, 0, 7795, 60032, 15492 ,0}),
+              myPrintPerft, perftDiff, free);
+
+    /* Position 5 Perft Tests, only node counts are published */
+    fprintf(stderr, " -- Position 5 Perft Tests -- \n");
+    loadFen(&b, "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+    RUN_TEST("Perft depth 1 - position 5", perftNodes(&b, 1), int, 44,
+              printInt, intDiff, noFree);
+    RUN_TEST("Perft depth 2 - position 5", perftNodes(&b, 2), int, 1486,
+              printInt, intDiff, noFree);
+    RUN_TEST("Perft depth 3 - position 5", perftNodes(&b, 3), int, 62379,
+              printInt, intDiff, noFree);
+    RUN_TEST("Perft depth 4 - position 5", perftNodes(&b, 4), int, 2103487,
+              printInt, intDiff, noFree);
+
+    /* Position 6 Perft Tests, only node counts are published */
+    fprintf(stderr, " -- Position 6 Perft Tests -- \n");
+    loadFen(&b, "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+    RUN_TEST("Perft depth 1 - position 6", perftNodes(&b, 1), int, 46,
+              printInt, intDiff, noFree);
+    RUN_TEST("Perft depth 2 - position 6", perftNodes(&b, 2), int, 2079,
+              printInt, intDiff, noFree);
+    RUN_TEST("Perft depth 3 - position 6", perftNodes(&b, 3), int, 89890,
+              printInt, intDiff, noFree);
+    RUN_TEST("Perft depth 4 - position 6", perftNodes(&b, 4), int, 3894594,
+              printInt, intDiff, noFree);
+
+    /* Bulk counted perft with the perft table */
+    fprintf(stderr, " -- Fast Perft Tests -- \n");
+    b = getDefaultBoard();
+    RUN_TEST("Fast perft depth 0", perftFast(&b, 0), uint64_t, 1,
+              printLongHex, xor64bit, noFree);
+    RUN_TEST("Fast perft depth 1", perftFast(&b, 1), uint64_t, 20,
+              printLongHex, xor64bit, noFree);
+    RUN_TEST("Fast perft depth 5", perftFast(&b, 5), uint64_t, 4865609,
+              printLongHex, xor64bit, noFree);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    RUN_TEST("Fast perft depth 4 - position 2", perftFast(&b, 4), uint64_t,
+              4085603, printLongHex, xor64bit, noFree);
+    loadFen(&b, "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    RUN_TEST("Fast perft depth 5 - position 3", perftFast(&b, 5), uint64_t,
+              674624, printLongHex, xor64bit, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("Fast perft depth 4 - position 4", perftFast(&b, 4), uint64_t,
+              422333, printLongHex, xor64bit, noFree);
+    loadFen(&b, "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+    RUN_TEST("Fast perft depth 4 - position 5", perftFast(&b, 4), uint64_t,
+              2103487, printLongHex, xor64bit, noFree);
+    loadFen(&b, "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+    RUN_TEST("Fast perft depth 4 - position 6", perftFast(&b, 4), uint64_t,
+              3894594, printLongHex, xor64bit, noFree);
+
+    /* Per root move counts of divide and go perft */
+    fprintf(stderr, " -- Divide Tests -- \n");
+    Move divideMoves[MAX_MOVES_PER_POSITION];
+    uint64_t divideCounts[MAX_MOVES_PER_POSITION];
+    b = getDefaultBoard();
+    RUN_TEST("Divide depth 3 moves", perftDivide(&b, 3, divideMoves,
+              divideCounts), int, 20, printInt, intDiff, noFree);
+    RUN_TEST("Divide depth 3 total", divideTotal(&b, 3), uint64_t, 8902,
+              printLongHex, xor64bit, noFree);
+    RUN_TEST("Divide depth 3 e2e4", divideMove(&b, 3, IE2, IE4), int64_t, 600,
+              printLongHex, xor64bit, noFree);
+    RUN_TEST("Divide depth 1 g1f3", divideMove(&b, 1, IG1, IF3), int64_t, 1,
+              printLongHex, xor64bit, noFree);
+    loadFen(&b, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    RUN_TEST("Divide depth 3 total - position 4", divideTotal(&b, 3), uint64_t,
+              9467, printLongHex, xor64bit, noFree);
+    RUN_TEST("Divide depth 2 g1h1 - position 4", divideMove(&b, 2, IG1, IH1),
+              int64_t, 46, printLongHex, xor64bit, noFree);
 
     /* Puzzle Proficiency */
     fprintf(stderr, "-- Puzzle Proficiency --\n");
@@ -514,6 +1649,97 @@ int tests()
     RUN_TEST("Puzzle 6b: Pawns can be important too!", findBestMove(&b, 5), Move, m,
         printMoveSAN, moveDiff, noFree);
 
+    /* Selective search, every technique on its own and all together */
+    fprintf(stderr, "-- Pruning --\n");
+    loadFen(&b, "3k4/5pQ1/3p4/1P2pP2/1Pr5/8/6PK/q7 w - - 0 32");
+    m = mcreate(0, IG7, IF8, QUEEN, 0, _WHITE);
+    RUN_TEST("No pruning: Puzzle 4w", findBestMovePruning(b, 5, 0), Move, m,
+        printMoveSAN, moveDiff, noFree);
+    RUN_TEST("Null move pruning: Puzzle 4w",
+        findBestMovePruning(b, 5, PRUNE_NULL_MOVE), Move, m, printMoveSAN,
+        moveDiff, noFree);
+    RUN_TEST("Late move reductions: Puzzle 4w",
+        findBestMovePruning(b, 5, PRUNE_LMR), Move, m, printMoveSAN,
+        moveDiff, noFree);
+    RUN_TEST("Futility pruning: Puzzle 4w",
+        findBestMovePruning(b, 5, PRUNE_FUTILITY), Move, m, printMoveSAN,
+        moveDiff, noFree);
+    RUN_TEST("All pruning: Puzzle 4w",
+        findBestMovePruning(b, 5, PRUNE_ALL), Move, m, printMoveSAN,
+        moveDiff, noFree);
+
+    /* Parallel search, both modes on the same positions for comparison */
+    fprintf(stderr, "-- Parallel Search --\n");
+    loadFen(&b, "7k/6b1/5Q1p/3P4/2pP4/1pP4P/1r1q2P1/4R1K1 w - - 4 36");
+    m = mcreate(0, IE1, IE8, ROOK, 0, _WHITE);
+    RUN_TEST("Lazy SMP, 4 threads: Puzzle 1w",
+        findBestMoveWith(b, 4, SEARCH_LAZY_SMP, 4), Move, m,
+        printMoveSAN, moveDiff, noFree);
+    RUN_TEST("YBWC, 4 threads: Puzzle 1w",
+        findBestMoveWith(b, 4, SEARCH_YBWC, 4), Move, m,
+        printMoveSAN, moveDiff, noFree);
+
+    loadFen(&b, "3k4/5pQ1/3p4/1P2pP2/1Pr5/8/6PK/q7 w - - 0 32");
+    m = mcreate(0, IG7, IF8, QUEEN, 0, _WHITE);
+    RUN_TEST("Lazy SMP, 4 threads: Puzzle 4w",
+        findBestMoveWith(b, 5, SEARCH_LAZY_SMP, 4), Move, m,
+        printMoveSAN, moveDiff, noFree);
+    RUN_TEST("YBWC, 4 threads: Puzzle 4w",
+        findBestMoveWith(b, 5, SEARCH_YBWC, 4), Move, m,
+        printMoveSAN, moveDiff, noFree);
+
+    loadFen(&b, "r3r3/1kp3QP/8/2p1p3/4P3/1P3P2/PKR4R/3q4 b - - 0 1");
+    m = mcreate(0, IA8, IA2, ROOK, 0, _BLACK);
+    RUN_TEST("Lazy SMP, 4 threads: Puzzle 5b",
+        findBestMoveWith(b, 5, SEARCH_LAZY_SMP, 4), Move, m,
+        printMoveSAN, moveDiff, noFree);
+    RUN_TEST("YBWC, 4 threads: Puzzle 5b",
+        findBestMoveWith(b, 5, SEARCH_YBWC, 4), Move, m,
+        printMoveSAN, moveDiff, noFree);
+
+    /* Time and node limits */
+    fprintf(stderr, "-- Search Limits --\n");
+    b = getDefaultBoard();
+    RUN_TEST("Search with movetime 200 stops in time",
+        searchStopsInTime(b, 200), int, 1, printInt, intDiff, noFree);
+    loadFen(&b, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+    RUN_TEST("Search with movetime 500 stops in time",
+        searchStopsInTime(b, 500), int, 1, printInt, intDiff, noFree);
+    RUN_TEST("Search with 200000 nodes stops in budget",
+        searchStopsAtNodes(b, 200000), int, 1, printInt, intDiff, noFree);
+    b = getDefaultBoard();
+    m = mcreate(0, IA2, IA3, PAWN, 0, _WHITE);
+    RUN_TEST("Search with searchmoves only plays those",
+        searchOnlyMove(b, 3, "a2a3"), Move, m, printMoveSAN, moveDiff, noFree);
+    loadFen(&b, "7k/3Q4/6K1/8/8/8/8/8 w - -");
+    RUN_TEST("Search mates instead of stalemating",
+        searchFindsMate(b, 3), int, 1, printInt, intDiff, noFree);
+    b = getDefaultBoard();
+    RUN_TEST("Search through aspiration windows repeats",
+        searchRepeats(b, 6), int, 1, printInt, intDiff, noFree);
+
+    /* EPD suites run by bench */
+    fprintf(stderr, " -- Bench -- \n");
+    uint64_t signature;
+    RUN_TEST("Bench perft counts match",
+        benchSuite("# startpos\n\n"
+                   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - "
+                   ";D1 20 ;D3 8902\n"
+                   "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1 ;D4 43238\n",
+                   2, &signature), int, 0, printInt, intDiff, noFree);
+    RUN_TEST("Bench signature is the single thread node count", signature,
+        uint64_t, 20 + 8902 + 43238, printLongHex, xor64bit, noFree);
+    RUN_TEST("Bench counts wrong perft counts",
+        benchSuite("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - "
+                   ";D2 400 ;D3 8903 ;id \"start\"\n", 1, NULL),
+        int, 1, printInt, intDiff, noFree);
+    RUN_TEST("Bench rejects a line without a position",
+        benchSuite(";D1 20\n", 1, NULL), int, -1, printInt, intDiff, noFree);
+    RUN_TEST("Bench signature repeats",
+        benchSignatureRepeats("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/"
+                              "PPPBBPPP/R3K2R w KQkq - ;acd 6\n"),
+        int, 1, printInt, intDiff, noFree);
+
     /*
     // This is a demonstration on how to use the reverseFen function.
     char rFen[256];
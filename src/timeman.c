@@ -0,0 +1,62 @@
+#include <time.h>
+
+#include "timeman.h"
+
+/* Set by timeStart, read by every search thread */
+static uint64_t startTime = 0;
+static uint64_t softTime = 0;
+static uint64_t hardTime = 0;
+
+uint64_t timeNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void timeStart(int time, int inc, int movestogo, int movetime)
+{
+    startTime = timeNow();
+    softTime = hardTime = 0;
+    if (movetime > 0)
+    {
+        softTime = hardTime = movetime > TIME_OVERHEAD
+                            ? movetime - TIME_OVERHEAD : 1;
+        return;
+    }
+    if (time < 0)
+        return;
+    // Never plan to use the time kept back for lag
+    uint64_t available = time > TIME_OVERHEAD ? time - TIME_OVERHEAD : 1;
+    int moves = movestogo > 0 && movestogo < TIME_MOVES_TO_GO
+              ? movestogo : TIME_MOVES_TO_GO;
+    softTime = time / moves + (inc > 0 ? inc * 3 / 4 : 0);
+    if (softTime > available) softTime = available;
+    if (!softTime) softTime = 1;
+    // Leave room for an iteration that runs long, but never bet the clock
+    hardTime = softTime * TIME_HARD_FACTOR;
+    if (hardTime > available * 3 / 4) hardTime = available * 3 / 4;
+    if (hardTime < softTime) hardTime = softTime;
+}
+
+uint64_t timeElapsed()
+{
+    return timeNow() - startTime;
+}
+
+int timeUp()
+{
+    return hardTime && timeElapsed() >= hardTime;
+}
+
+int timeNextIteration(uint64_t last, uint64_t before)
+{
+    if (!hardTime) return 1;
+    uint64_t elapsed = timeElapsed();
+    if (elapsed >= softTime) return 0;
+    // Iterations too short to measure don't say much about the next one
+    uint64_t growth = before ? last / before : 2;
+    if (growth < 2) growth = 2;
+    if (growth > 8) growth = 8;
+    return elapsed + last * growth <= hardTime;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>     // aligned_alloc(), free()
+#include <string.h>     // memset()
+
+#include "tt.h"
+
+/* Table of buckets, each bucket holds TT_BUCKET_SIZE entries */
+static TTEntry *table = NULL;
+static uint64_t bucketMask = 0;
+static uint8_t generation = 0;
+
+/*
+ * Entries are read and written with relaxed atomics. On x86 these compile to
+ * plain loads and stores, they only stop the compiler from tearing or caching
+ * accesses that another thread may be making at the same time
+ */
+#define ttload(x)     __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define ttstore(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+int ttResize(size_t mb)
+{
+    uint64_t buckets = 1;
+    uint64_t bucketBytes = TT_BUCKET_SIZE * sizeof(TTEntry);
+    while ((buckets << 1) * bucketBytes <= (uint64_t)mb << 20)
+        buckets <<= 1;
+    TTEntry *newTable = aligned_alloc(64, buckets * bucketBytes);
+    if (!newTable)
+    {
+        fprintf(stderr, "Could not allocate a %zuMB transposition table\n", mb);
+        return 1;
+    }
+    free(table);
+    table = newTable;
+    bucketMask = buckets - 1;
+    ttClear();
+    return 0;
+}
+
+void ttClear()
+{
+    memset(table, 0, (bucketMask + 1) * TT_BUCKET_SIZE * sizeof(TTEntry));
+    generation = 0;
+}
+
+void ttNewSearch()
+{
+    generation++;
+}
+
+int ttProbe(uint64_t hash, uint64_t *data)
+{
+    TTEntry *bucket = table + (hash & bucketMask) * TT_BUCKET_SIZE;
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i)
+    {
+        uint64_t d = ttload(bucket[i].data);
+        if ((ttload(bucket[i].key) ^ d) == hash && ttgetbound(d) != TT_NONE)
+        {
+            *data = d;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void ttStore(uint64_t hash, Move move, int score, int depth, int bound)
+{
+    TTEntry *bucket = table + (hash & bucketMask) * TT_BUCKET_SIZE;
+    TTEntry *replace = bucket;
+    int replaceValue = 0x7fffffff;
+    for (int i = 0; i < TT_BUCKET_SIZE; ++i)
+    {
+        uint64_t d = ttload(bucket[i].data);
+        if ((ttload(bucket[i].key) ^ d) == hash)
+        {
+            // Keep the old best move if this search didn't find one
+            if (!move) move = ttgetmove(d);
+            replace = bucket + i;
+            break;
+        }
+        // Prefer replacing shallow entries and ones from earlier searches
+        int value = ttgetdepth(d) - 8 * (uint8_t)(generation - ttgetgen(d));
+        if (value < replaceValue)
+        {
+            replaceValue = value;
+            replace = bucket + i;
+        }
+    }
+    uint64_t data = (uint64_t)(move & 0x7ffff)
+                  | ((uint64_t)(bound & 0x3) << 19)
+                  | ((uint64_t)(depth & 0xff) << 21)
+                  | ((uint64_t)(score & 0xffff) << 29)
+                  | ((uint64_t)generation << 45);
+    ttstore(replace->key, hash ^ data);
+    ttstore(replace->data, data);
+}
@@ -1,13 +1,138 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>   // strcasecmp()
 #include <stdlib.h>
+#include <ctype.h>     // isdigit()
 
 #include "uci.h"
+#include "bench.h"
 #include "board.h"
 #include "engine.h"
 #include "timer.h"
-#include "bitHelpers.h"
+#include "tt.h"
+#include "timeman.h"
+#include "nnue.h"
+
+/*******************************************************************************
+ *
+ * Option functions
+ *
+ * These functions are called by setoption. They take the value string given
+ * after "value", or NULL if there was none, and return 1 if the option was
+ * set.
+ *
+ ******************************************************************************/
+
+int optionHash(char* value)
+{
+    int mb = value ? atoi(value) : 0;
+    if (mb < 1) {
+        fprintf(stderr, "Hash must be at least 1MB: %s\n", value);
+        return 0;
+    }
+    return !ttResize(mb);
+}
+
+int optionThreads(char* value)
+{
+    int threads = value ? atoi(value) : 0;
+    if (threads < 1 || threads > MAX_THREADS) {
+        fprintf(stderr, "Threads must be between 1 and %d: %s\n", MAX_THREADS,
+                value);
+        return 0;
+    }
+    g_state.threads = threads;
+    return 1;
+}
+
+int optionSearchMode(char* value)
+{
+    if (value && !strcasecmp(value, "LazySMP"))
+        g_state.searchMode = SEARCH_LAZY_SMP;
+    else if (value && !strcasecmp(value, "YBWC"))
+        g_state.searchMode = SEARCH_YBWC;
+    else {
+        fprintf(stderr, "SearchMode must be LazySMP or YBWC: %s\n", value);
+        return 0;
+    }
+    return 1;
+}
+
+int optionEvalFile(char* value)
+{
+    // An empty path goes back to the classical evaluation
+    if (!value || !*value || !strcmp(value, "<empty>")) {
+        nnueDisable();
+        return 1;
+    }
+    return !nnueLoad(value);
+}
+
+/*
+ * Sets or clears flag in g_state.pruning from a check option value, "true" or
+ * "false"
+ */
+static int setPruning(char* value, int flag, const char* name)
+{
+    if (value && !strcasecmp(value, "true"))
+        g_state.pruning |= flag;
+    else if (value && !strcasecmp(value, "false"))
+        g_state.pruning &= ~flag;
+    else {
+        fprintf(stderr, "%s must be true or false: %s\n", name, value);
+        return 0;
+    }
+    return 1;
+}
+
+int optionNullMove(char* value)
+{
+    return setPruning(value, PRUNE_NULL_MOVE, "NullMove");
+}
+
+int optionLMR(char* value)
+{
+    return setPruning(value, PRUNE_LMR, "LMR");
+}
+
+int optionFutility(char* value)
+{
+    return setPruning(value, PRUNE_FUTILITY, "Futility");
+}
+
+int optionPerftSplit(char* value)
+{
+    int plies = value ? atoi(value) : -1;
+    if (plies < 0 || plies > PERFT_SPLIT_MAX || (value && !isdigit(*value))) {
+        fprintf(stderr, "PerftSplit must be between 0 and %d: %s\n",
+                PERFT_SPLIT_MAX, value);
+        return 0;
+    }
+    g_state.perftSplit = plies;
+    return 1;
+}
+
+/* This struct holds all of the options that can be set with setoption. The
+ * format is the name of the option, the rest of the "option" line sent for the
+ * uci command, and a function pointer to be called with the new value. The
+ * last entry is filled with zeros to mark the end of the array.
+ */
+Option alloptions[] = {
+    {"Hash", "type spin default " STR(TT_DEFAULT_MB) " min 1 max 65536",
+        optionHash},
+    {"Threads", "type spin default " STR(NUM_THREADS) " min 1 max "
+        STR(MAX_THREADS), optionThreads},
+    {"SearchMode", "type combo default LazySMP var LazySMP var YBWC",
+        optionSearchMode},
+    {"EvalFile", "type string default <empty>", optionEvalFile},
+    {"NullMove", "type check default true", optionNullMove},
+    {"LMR", "type check default true", optionLMR},
+    {"Futility", "type check default true", optionFutility},
+    {"PerftSplit", "type spin default " STR(PERFT_SPLIT_DEPTH) " min 0 max "
+        STR(PERFT_SPLIT_MAX), optionPerftSplit},
+    {{0},{0},0}
+};
 
 /*******************************************************************************
  *
@@ -34,8 +159,16 @@ int uci(Board* board, char* command)
     char *s = {
         "id name Lefoux " LEFOUX_VERSION "\n"
         "id author Hayden Johnson and Zachary Gorman\n"
-        "uciok\n"
     };
+    if (write(1, s, strlen(s)) == -1)
+        fprintf(stderr, "Error writing to stdout");
+    Option* o;
+    for (o = alloptions; o->name[0] != 0; o++)
+    {
+        if (dprintf(1, "option name %s %s\n", o->name, o->description) < 0)
+            fprintf(stderr, "Error writing to stdout");
+    }
+    s = "uciok\n";
     if (write(1, s, strlen(s)) == -1)
         fprintf(stderr, "Error writing to stdout");
     return 1;
@@ -85,6 +218,53 @@ int position(Board* board, char* command)
     return 1;
 }
 
+/*
+ * Prints the leaf count below every root move to depth, then the total. With
+ * csv set each line is "<move>,<count>" and the total is "total,<count>",
+ * otherwise "<move>: <count>" and "Nodes searched: <count>"
+ */
+static void printDivide(Board* board, int depth, int csv)
+{
+    Move moves[MAX_MOVES_PER_POSITION];
+    uint64_t counts[MAX_MOVES_PER_POSITION];
+    int n = perftDivide(board, depth, moves, counts);
+    uint64_t total = 0;
+    char s[7];
+    for (int i = 0; i < n; ++i) {
+        sprintLANMove(s, moves[i]);
+        s[strlen(s) - 1] = '\0';
+        printf(csv ? "%s,%lu\n" : "%s: %lu\n", s, counts[i]);
+        total += counts[i];
+    }
+    printf(csv ? "total,%lu\n" : "\nNodes searched: %lu\n", total);
+    fflush(stdout);
+}
+
+/*
+ * Clock sent with go ponder. The time manager only starts on ponderhit, when
+ * the opponent played the move being pondered on
+ */
+static int ponderTime = -1;
+static int ponderInc = 0;
+static int ponderMovesToGo = 0;
+static int ponderMoveTime = 0;
+
+/*
+ * Writes "bestmove <move>" for g_state.bestMove and stops pondering. Callers
+ * hold the bestmove critical section, so it is sent only once per search
+ */
+static void sendBestMove()
+{
+    char s[] = {"bestmove a1h8q\n"};
+    sprintLANMove(s + 9, g_state.bestMove);
+    // A promotion fills the buffer, so the space after the move becomes the
+    // newline
+    s[strlen(s) - 1] = '\n';
+    if (write(1, s, strlen(s)) == -1)
+        fprintf(stderr, "Error writing to stdout");
+    g_state.flags &= ~UCI_PONDER;
+}
+
 int go(Board* board, char* command)
 {
     char *saveptr;
@@ -96,9 +276,25 @@ int go(Board* board, char* command)
     int depth = 5;
     int ponder = 0;
     int maxTime = 0;
+    int time[2] = {-1, -1};
+    int inc[2] = {0, 0};
+    int movestogo = 0;
+    int depthGiven = 0;
+    uint64_t nodes = 0;
     /* go subcommand */
     while ( (token = strtok_r(NULL, " \n", &saveptr)) )
     {
+        if (token && !strcmp(token, "perft"))
+        {
+            /* token is the depth to count to, nothing is searched */
+            token = strtok_r(NULL, " \n", &saveptr);
+            if (!token || atoi(token) < 1) {
+                fprintf(stderr, "Use: go perft <depth>\n");
+                return 1;
+            }
+            printDivide(board, atoi(token), 0);
+            return 1;
+        }
         if (token && !strcmp(token, "searchmoves"))
         {
             while ( (token = strtok_r(NULL, " \n", &saveptr)) )
@@ -116,46 +312,52 @@ int go(Board* board, char* command)
         {
             /* token is number of ms left on the clock for white */
             token = strtok_r(NULL, " \n", &saveptr);
+            if (token) time[_WHITE] = atoi(token);
         }
         if (token && !strcmp(token, "btime"))
         {
             /* token is number of ms left on the clock for black */
             token = strtok_r(NULL, " \n", &saveptr);
+            if (token) time[_BLACK] = atoi(token);
         }
         if (token && !strcmp(token, "winc"))
         {
             /* token is white's increment per move in ms if x > 0 */
             token = strtok_r(NULL, " \n", &saveptr);
+            if (token) inc[_WHITE] = atoi(token);
         }
         if (token && !strcmp(token, "binc"))
         {
             /* token is black's increment per move in ms if x > 0 */
             token = strtok_r(NULL, " \n", &saveptr);
+            if (token) inc[_BLACK] = atoi(token);
         }
         if (token && !strcmp(token, "movestogo"))
         {
             /* token is the number of moves until next time control */
             token = strtok_r(NULL, " \n", &saveptr);
+            if (token) movestogo = atoi(token);
         }
         if (token && !strcmp(token, "depth"))
         {
             /* token is the number of plies to search */
             token = strtok_r(NULL, " \n", &saveptr);
             depth = atoi(token);
+            depthGiven = 1;
         }
         if (token && !strcmp(token, "nodes"))
         {
             /* token is the number of nodes to search */
             token = strtok_r(NULL, " \n", &saveptr);
-            depth = atoi(token);
-            // An estimate conversion from number of nodes to ply
-            depth = bitScanReverse(depth);
+            if (token) nodes = strtoull(token, NULL, 10);
         }
         if (token && !strcmp(token, "mate"))
         {
-            /* token is the number of moves to find a mate */
+            /* token is the number of moves to find a mate, the search has
+             * to see the position after the last one */
             token = strtok_r(NULL, " \n", &saveptr);
-            depth = atoi(token);
+            depth = 2 * atoi(token);
+            depthGiven = 1;
         }
         if (token && !strcmp(token, "movetime"))
         {
@@ -166,66 +368,46 @@ int go(Board* board, char* command)
         if (token && !strcmp(token, "infinite"))
         {
             /* Search until the "stop" command */
-            depth = 0xff;
+            depth = MAX_SEARCH_DEPTH;
+            depthGiven = 1;
         }
     }
-    g_state.flags &= ~UCI_STOP;
-    // Task to start searching
-    // Don't spawn task with only 1 thread since it won't get picked up
-    // and will hang
-    #if NUM_THREADS > 1
-    #pragma omp task untied
-    #endif
-    {
-        // This section is basically the guts of findBestMove
-        g_state.bestMove = msetweight(0, -127);
-        if (!numMoves) g_state.bestMove = findBestMove(board, depth);
-        int i;
-        for (i=0; i<numMoves; i++)
-        {
-            Move undoM = boardMove(board, moves[i]);
-            moves[i] = msetweight(moves[i],
-                    mgetweight(findBestMove(board, depth)));
-            undoMove(board, undoM);
-            if (g_state.flags & UCI_STOP) break;
-            // Update global state in case this is interrupted
-            if (mgetweight(moves[i]) > mgetweight(g_state.bestMove))
-                g_state.bestMove = moves[i];
-        }
-        g_state.flags |= UCI_STOP;
-        qsort(moves, i, sizeof(Move), compareMoveWeights);
-        if (numMoves) g_state.bestMove = moves[0];
-        for (i = 0; i < numMoves; ++i)
-        {
-            if (mgetweight(moves[i]) != mgetweight(g_state.bestMove))
-                break;
-        }
-        // If there are many bestMoves, pick one randomly
-        if (i - 1 > 0)
-            g_state.bestMove = moves[rand() % (i - 1)];
-        /* Deliver bestMove */
-        if (!ponder) {
-            char s[] = {"bestmove a1h8q\n"};
-            sprintLANMove(s + 9, g_state.bestMove);
-            int n = strlen(s);
-            s[n] = '\n';
-            if (write(1, s, strlen(s)) == -1)
-                fprintf(stderr, "Error writing to stdout");
-        }
+    int us = bgetcol(board->info);
+    // Only the clock or node budget decides how deep to go, unless a depth
+    // was asked for
+    if (!depthGiven && (maxTime || time[us] >= 0 || nodes))
+        depth = MAX_SEARCH_DEPTH;
+    if (depth > MAX_SEARCH_DEPTH) depth = MAX_SEARCH_DEPTH;
+    // The clock is ours only once the opponent plays the pondered move, so
+    // a ponder search has no deadlines until ponderhit
+    if (ponder) {
+        ponderTime = time[us];
+        ponderInc = inc[us];
+        ponderMovesToGo = movestogo;
+        ponderMoveTime = maxTime;
+        timeStart(-1, 0, 0, 0);
+    } else {
+        timeStart(time[us], inc[us], movestogo, maxTime);
     }
-    // Task to time the search
-    // Don't spawn task with fewer than 3 threads, otherwise timer starts
-    // after search is finished
-    #if NUM_THREADS >= 3
-    if (maxTime)
+    setNodeLimit(nodes);
+    setSearchMoves(moves, numMoves);
+    g_state.flags &= ~(UCI_STOP | UCI_PONDER);
+    g_state.flags |= UCI_SEARCHING | (ponder ? UCI_PONDER : 0);
+    // Task to start searching, findBestMove starts its own team of search
+    // threads and stops itself when the time is up
+    #pragma omp task
     {
-        #pragma omp task untied
+        g_state.bestMove = 0;
+        g_state.bestMove = findBestMove(board, depth);
+        /* Deliver bestMove. A ponder search that finished on its own keeps
+         * UCI_PONDER set, and stop or ponderhit delivers it */
+        #pragma omp critical(bestmove)
         {
-            usleep(maxTime * 1000);
-            g_state.flags |= UCI_STOP;
+            if (!(g_state.flags & UCI_PONDER) || (g_state.flags & UCI_STOP))
+                sendBestMove();
+            g_state.flags &= ~UCI_SEARCHING;
         }
     }
-    #endif
 
     return 1;
 }
@@ -238,36 +420,69 @@ int debug(Board* board, char* command)
 
 int setoption(Board* board, char* command)
 {
-    char* s = "readyok\n";
-    if (write(1, s, strlen(s)) == -1)
-        fprintf(stderr, "Error writing to stdout");
+    /* Format is "setoption name <id> [value <x>]", where id may have spaces */
+    char *name = strstr(command, "name ");
+    if (!name) {
+        fprintf(stderr, "No option name given. Use: setoption name <id> "
+                        "[value <x>]\n");
+        return 1;
+    }
+    name += strlen("name ");
+    char *value = strstr(name, " value ");
+    char *end = value ? value : name + strcspn(name, "\n");
+    if (value) {
+        value += strlen(" value ");
+        value[strcspn(value, "\n")] = '\0';
+    }
+    *end = '\0';
+    Option* o;
+    for (o = alloptions; o->name[0] != 0; o++)
+    {
+        if (!strcasecmp(o->name, name))
+        {
+            if (!o->func(value))
+                fprintf(stderr, "Could not set option %s\n", o->name);
+            return 1;
+        }
+    }
+    fprintf(stderr, "Unknown option: %s\n", name);
     return 1;
 }
 
 int ucinewgame(Board* board, char* command)
 {
     *board = getDefaultBoard();
+    ttClear();
     return 1;
 }
 
 int stop(Board* board, char* command)
 {
-    g_state.flags |= UCI_STOP;
-    char s[] = {"bestmove a1h8q\n"};
-    sprintLANMove(s + 9, g_state.bestMove);
-    int n = strlen(s);
-    s[n] = '\n';
-    // printMove(g_state.bestMove);
-    if (write(1, s, strlen(s)) == -1)
-        fprintf(stderr, "Error writing to stdout");
+    // A running search sees UCI_STOP and delivers bestmove itself, only a
+    // finished ponder search is still owed one
+    #pragma omp critical(bestmove)
+    {
+        g_state.flags |= UCI_STOP;
+        if ((g_state.flags & UCI_PONDER) && !(g_state.flags & UCI_SEARCHING))
+            sendBestMove();
+    }
     return 1;
 }
 
 int ponderhit(Board* board, char* command)
 {
-    char* s = "readyok\n";
-    if (write(1, s, strlen(s)) == -1)
-        fprintf(stderr, "Error writing to stdout");
+    // The pondered move was played: the search goes on as a normal one on
+    // the clock sent with go ponder, counted from now
+    #pragma omp critical(bestmove)
+    {
+        if (g_state.flags & UCI_PONDER) {
+            timeStart(ponderTime, ponderInc, ponderMovesToGo, ponderMoveTime);
+            if (g_state.flags & UCI_SEARCHING)
+                g_state.flags &= ~UCI_PONDER;
+            else
+                sendBestMove();
+        }
+    }
     return 1;
 }
 
@@ -288,7 +503,7 @@ int perft(Board* board, char* command)
     char *token = strtok_r(command, " \n", &saveptr);
     /* Get depth */
     if (!(token = strtok_r(NULL, " \n", &saveptr))) {
-        fprintf(stderr, "No depth given. Use: perft <depth>\n");
+        fprintf(stderr, "No depth given. Use: perft <depth> [--fast]\n");
         return 1;
     }
 
@@ -302,17 +517,74 @@ int perft(Board* board, char* command)
         return 1;
     }
 
+    /* --fast only counts nodes */
+    char *option = strtok_r(NULL, " \n", &saveptr);
+    if (option && strcmp(option, "--fast")) {
+        fprintf(stderr, "Unknown perft option: %s\n", option);
+        return 1;
+    }
+
     Timer t;
     PerftInfo p = {0};
     StartTimer(&t);
-    perftRunThreaded(board, &p, depth);
+    if (option)
+        p.nodes = perftFast(board, depth);
+    else
+        perftRunThreaded(board, &p, depth);
     StopTimer(&t);
     #ifdef CSV
     printf("%.6f,", t.time_taken);
     #else
     printf("Took %.6f seconds\n", t.time_taken);
     #endif
-    printPerft(p);
+    if (!option) {
+        printPerft(p);
+        return 1;
+    }
+    #ifdef CSV
+    printf("%d,%ld\n", g_state.threads, p.nodes);
+    #else
+    printf("\nNodes: %ld\n", p.nodes);
+    #endif
+    return 1;
+}
+
+int divide(Board* board, char* command)
+{
+    char *saveptr;
+    /* token should be "divide" */
+    char *token = strtok_r(command, " \n", &saveptr);
+    token = strtok_r(NULL, " \n", &saveptr);
+    int depth = token ? atoi(token) : 0;
+    if (depth < 1) {
+        fprintf(stderr, "Use: divide <depth> [--csv]\n");
+        return 1;
+    }
+    /* --csv prints one "move,count" line per move for scripts */
+    char *option = strtok_r(NULL, " \n", &saveptr);
+    if (option && strcmp(option, "--csv")) {
+        fprintf(stderr, "Unknown divide option: %s\n", option);
+        return 1;
+    }
+    printDivide(board, depth, option != NULL);
+    return 1;
+}
+
+int bench(Board* board, char* command)
+{
+    char *saveptr;
+    /* token should be "bench" */
+    char *token = strtok_r(command, " \n", &saveptr);
+    /* Optional suite to run instead of BENCH_FILE */
+    token = strtok_r(NULL, " \n", &saveptr);
+    const char *path = token ? token : BENCH_FILE;
+    FILE *epd = fopen(path, "r");
+    if (!epd) {
+        fprintf(stderr, "Could not open bench file %s\n", path);
+        return 1;
+    }
+    runBench(epd, NULL);
+    fclose(epd);
     return 1;
 }
 
@@ -344,6 +616,8 @@ Command allcommands[] = {
     // Non-uci commands
     {"printboard", printboard},
     {"perft", perft},
+    {"divide", divide},
+    {"bench", bench},
     {"fen", fen},
     {{0},0} // https://gcc.gnu.org/bugzilla/show_bug.cgi?id=53119
 };